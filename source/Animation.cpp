@@ -0,0 +1,390 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "Profiler.h"
+#include "Scene.h"
+#include "Timer.h"
+
+namespace dae
+{
+	namespace Animation
+	{
+		namespace
+		{
+			struct Frame
+			{
+				int index{};
+				std::vector<uint8_t> rgb{};
+			};
+
+			//BT.601 limited range, what players assume for Y4M without colour tags
+			uint8_t GetLuma(int r, int g, int b)
+			{
+				return static_cast<uint8_t>(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+			}
+
+			uint8_t GetChromaBlue(int r, int g, int b)
+			{
+				return static_cast<uint8_t>(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+			}
+
+			uint8_t GetChromaRed(int r, int g, int b)
+			{
+				return static_cast<uint8_t>(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+			}
+
+			//Y4M wants frames per second as a fraction, 1/30 s should still come out as 30:1
+			std::string GetFrameRate(float timeStep)
+			{
+				const double framesPerSecond{ 1.0 / std::max(timeStep, 1e-6f) };
+				if (std::abs(framesPerSecond - std::round(framesPerSecond)) < 1e-3)
+					return std::to_string(std::llround(framesPerSecond)) + ":1";
+
+				const long long denominator{ std::max(std::llround(timeStep * 1000000.0), 1ll) };
+				const long long divisor{ std::gcd(1000000ll, denominator) };
+				return std::to_string(1000000ll / divisor) + ":" + std::to_string(denominator / divisor);
+			}
+
+			/**
+			 * Owns the encoder threads. Frames are picked up in the order they were submitted,
+			 * the Y4M stream additionally makes every thread wait for its turn before writing.
+			 */
+			class FrameEncoder final
+			{
+			public:
+				FrameEncoder(const BatchRenderSettings& settings)
+					: m_Settings{ settings }
+					, m_NextFrameToWrite{ settings.firstFrame }
+				{
+				}
+
+				~FrameEncoder()
+				{
+					Finish();
+				}
+
+				FrameEncoder(const FrameEncoder&) = delete;
+				FrameEncoder(FrameEncoder&&) noexcept = delete;
+				FrameEncoder& operator=(const FrameEncoder&) = delete;
+				FrameEncoder& operator=(FrameEncoder&&) noexcept = delete;
+
+				bool Start()
+				{
+					std::error_code error{};
+					if (m_Settings.format == OutputFormat::ImageSequence)
+					{
+						std::filesystem::create_directories(m_Settings.output, error);
+					}
+					else
+					{
+						const std::filesystem::path parentPath{ std::filesystem::path(m_Settings.output).parent_path() };
+						if (!parentPath.empty())
+							std::filesystem::create_directories(parentPath, error);
+
+						m_Stream.open(m_Settings.output, std::ios::binary);
+						if (!m_Stream)
+						{
+							std::cout << "Could not open " << m_Settings.output << std::endl;
+							return false;
+						}
+
+						m_Stream << "YUV4MPEG2 W" << m_Settings.width << " H" << m_Settings.height
+							<< " F" << GetFrameRate(m_Settings.timeStep) << " Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n";
+					}
+
+					for (int i{ 0 }; i < std::max(m_Settings.encoderThreads, 1); ++i)
+						m_Threads.emplace_back(&FrameEncoder::EncoderThread, this);
+
+					return true;
+				}
+
+				//Blocks while maxFramesInFlight frames are still waiting to be written, returns the seconds spent waiting
+				double Submit(Frame&& frame)
+				{
+					const auto start = std::chrono::steady_clock::now();
+
+					std::unique_lock lock{ m_Mutex };
+					m_SlotCondition.wait(lock, [this] { return m_FramesInFlight < std::max(m_Settings.maxFramesInFlight, 1); });
+
+					++m_FramesInFlight;
+					m_PeakFramesInFlight = std::max(m_PeakFramesInFlight, m_FramesInFlight);
+					m_Queue.emplace_back(std::move(frame));
+					lock.unlock();
+					m_QueueCondition.notify_one();
+
+					return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				}
+
+				//Waits until every submitted frame is written, returns false when any write failed
+				bool Finish()
+				{
+					{
+						std::lock_guard lock{ m_Mutex };
+						m_IsStopping = true;
+					}
+					m_QueueCondition.notify_all();
+
+					for (std::thread& thread : m_Threads)
+						thread.join();
+					m_Threads.clear();
+
+					if (m_Stream.is_open())
+					{
+						m_Stream.close();
+						if (m_Stream.fail())
+							m_HasFailed = true;
+					}
+
+					return !m_HasFailed;
+				}
+
+				bool HasFailed() const { return m_HasFailed; }
+				int GetPeakFramesInFlight() const { return m_PeakFramesInFlight; }
+
+			private:
+				const BatchRenderSettings& m_Settings;
+
+				std::mutex m_Mutex{};
+				//Frame queued or stopping
+				std::condition_variable m_QueueCondition{};
+				//Frame written, its slot is free again
+				std::condition_variable m_SlotCondition{};
+				//Y4M frame written, the next one may go
+				std::condition_variable m_TurnCondition{};
+
+				std::deque<Frame> m_Queue{};
+				int m_FramesInFlight{};
+				int m_PeakFramesInFlight{};
+				int m_NextFrameToWrite{};
+				bool m_IsStopping{ false };
+				std::atomic<bool> m_HasFailed{ false };
+
+				std::ofstream m_Stream{};
+				std::vector<std::thread> m_Threads{};
+
+				void EncoderThread()
+				{
+					while (true)
+					{
+						Frame frame{};
+						{
+							std::unique_lock lock{ m_Mutex };
+							m_QueueCondition.wait(lock, [this] { return !m_Queue.empty() || m_IsStopping; });
+							if (m_Queue.empty())
+								return;
+
+							frame = std::move(m_Queue.front());
+							m_Queue.pop_front();
+						}
+
+						if (m_Settings.format == OutputFormat::ImageSequence)
+							WriteImage(frame);
+						else
+							WriteY4MFrame(frame, EncodeY4MFrame(frame));
+
+						{
+							std::lock_guard lock{ m_Mutex };
+							--m_FramesInFlight;
+						}
+						m_SlotCondition.notify_one();
+					}
+				}
+
+				void WriteImage(const Frame& frame)
+				{
+					PROFILE_ZONE("Write Image");
+
+					char number[16]{};
+					std::snprintf(number, sizeof(number), "%05d", frame.index);
+					const std::string filename{ m_Settings.output + "/" + m_Settings.sceneName + "_" + number + ".ppm" };
+
+					std::ofstream file(filename, std::ios::binary);
+					file << "P6\n" << m_Settings.width << " " << m_Settings.height << "\n255\n";
+					file.write(reinterpret_cast<const char*>(frame.rgb.data()), frame.rgb.size());
+					if (!file)
+					{
+						std::cout << "Could not write " << filename << std::endl;
+						m_HasFailed = true;
+					}
+				}
+
+				//RGB to planar Y'CbCr, chroma is the average of each 2x2 block (odd edges repeat the last pixel)
+				std::vector<uint8_t> EncodeY4MFrame(const Frame& frame) const
+				{
+					PROFILE_ZONE("Encode Y4M");
+
+					const int width{ m_Settings.width };
+					const int height{ m_Settings.height };
+					const int chromaWidth{ (width + 1) / 2 };
+					const int chromaHeight{ (height + 1) / 2 };
+
+					constexpr char frameHeader[]{ "FRAME\n" };
+					constexpr size_t headerSize{ sizeof(frameHeader) - 1 };
+					const size_t lumaSize{ static_cast<size_t>(width) * height };
+					const size_t chromaSize{ static_cast<size_t>(chromaWidth) * chromaHeight };
+
+					std::vector<uint8_t> data(headerSize + lumaSize + 2 * chromaSize);
+					std::memcpy(data.data(), frameHeader, headerSize);
+
+					uint8_t* pLuma{ data.data() + headerSize };
+					uint8_t* pChromaBlue{ pLuma + lumaSize };
+					uint8_t* pChromaRed{ pChromaBlue + chromaSize };
+					const uint8_t* pRGB{ frame.rgb.data() };
+
+					for (size_t i{ 0 }; i < lumaSize; ++i)
+						pLuma[i] = GetLuma(pRGB[i * 3], pRGB[i * 3 + 1], pRGB[i * 3 + 2]);
+
+					for (int cy{ 0 }; cy < chromaHeight; ++cy)
+					{
+						const int y0{ cy * 2 };
+						const int y1{ std::min(y0 + 1, height - 1) };
+						for (int cx{ 0 }; cx < chromaWidth; ++cx)
+						{
+							const int x0{ cx * 2 };
+							const int x1{ std::min(x0 + 1, width - 1) };
+
+							int sum[3]{};
+							for (const int y : { y0, y1 })
+							{
+								for (const int x : { x0, x1 })
+								{
+									const uint8_t* pPixel{ pRGB + (static_cast<size_t>(y) * width + x) * 3 };
+									sum[0] += pPixel[0];
+									sum[1] += pPixel[1];
+									sum[2] += pPixel[2];
+								}
+							}
+
+							const int r{ (sum[0] + 2) / 4 };
+							const int g{ (sum[1] + 2) / 4 };
+							const int b{ (sum[2] + 2) / 4 };
+
+							const size_t chromaIndex{ static_cast<size_t>(cy) * chromaWidth + cx };
+							pChromaBlue[chromaIndex] = GetChromaBlue(r, g, b);
+							pChromaRed[chromaIndex] = GetChromaRed(r, g, b);
+						}
+					}
+
+					return data;
+				}
+
+				//Frames of a stream have to land in order, encoding above still overlaps
+				void WriteY4MFrame(const Frame& frame, const std::vector<uint8_t>& data)
+				{
+					std::unique_lock lock{ m_Mutex };
+					m_TurnCondition.wait(lock, [this, &frame] { return m_NextFrameToWrite == frame.index; });
+					lock.unlock();
+
+					{
+						PROFILE_ZONE("Write Y4M");
+						m_Stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+						if (!m_Stream)
+							m_HasFailed = true;
+					}
+
+					lock.lock();
+					++m_NextFrameToWrite;
+					lock.unlock();
+					m_TurnCondition.notify_all();
+				}
+			};
+		}
+
+		int RunBatchRender(const BatchRenderSettings& settings)
+		{
+			if (settings.lastFrame < settings.firstFrame || settings.width <= 0 || settings.height <= 0)
+			{
+				std::cout << "Nothing to render for frames [" << settings.firstFrame << ", " << settings.lastFrame << "]" << std::endl;
+				return 1;
+			}
+
+			std::unique_ptr<Scene> pScene{};
+			for (const SceneFactory& factory : GetSceneFactories())
+			{
+				if (settings.sceneName == factory.name)
+					pScene = factory.create();
+			}
+
+			if (!pScene)
+			{
+				std::cout << "Unknown scene " << settings.sceneName << std::endl;
+				return 1;
+			}
+
+			const int frameCount{ settings.lastFrame - settings.firstFrame + 1 };
+			const double frameMegaBytes{ static_cast<double>(settings.width) * settings.height * 3 / (1024.0 * 1024.0) };
+
+			std::cout << std::fixed << std::setprecision(2);
+			std::cout << "**BATCH RENDER STARTED** " << settings.sceneName << " " << settings.width << "x" << settings.height
+				<< ", frames [" << settings.firstFrame << ", " << settings.lastFrame << "] to " << settings.output
+				<< ", at most " << settings.maxFramesInFlight << " frames (" << settings.maxFramesInFlight * frameMegaBytes << " MB) in flight\n";
+
+			pScene->Initialize();
+
+			Renderer renderer{ settings.width, settings.height };
+			if (!renderer.IsValid())
+				return 1;
+			renderer.SetShadowsEnabled(settings.shadowsEnabled);
+			renderer.SetLightingMode(settings.lightingMode);
+
+			FrameEncoder encoder{ settings };
+			if (!encoder.Start())
+				return 1;
+
+			Timer timer{};
+			double renderSeconds{};
+			double waitSeconds{};
+			const auto start = std::chrono::steady_clock::now();
+
+			for (int frame{ settings.firstFrame }; frame <= settings.lastFrame && !encoder.HasFailed(); ++frame)
+			{
+				//Same time for a frame no matter where the range starts, so ranges can be split over machines
+				timer.SetSimulatedTime(frame * settings.timeStep, settings.timeStep);
+
+				const auto renderStart = std::chrono::steady_clock::now();
+				{
+					PROFILE_ZONE("Frame");
+					{
+						PROFILE_ZONE("Scene::Update");
+						pScene->Update(&timer);
+					}
+					renderer.Render(pScene.get());
+				}
+				renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+
+				waitSeconds += encoder.Submit({ frame, renderer.GetBufferRGB() });
+
+				const int framesDone{ frame - settings.firstFrame + 1 };
+				if (framesDone % 10 == 0 || frame == settings.lastFrame)
+					std::cout << ">> " << framesDone << "/" << frameCount << " frames rendered\n";
+			}
+
+			const bool isWritten{ encoder.Finish() };
+			const double totalSeconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+
+			std::cout << "**BATCH RENDER " << (isWritten ? "FINISHED" : "FAILED") << "** " << totalSeconds << " s total, "
+				<< renderSeconds * 1000.0 / frameCount << " ms/frame rendering, "
+				<< waitSeconds << " s waiting on the encoders, peak " << encoder.GetPeakFramesInFlight() << " frames in flight" << std::endl;
+
+			return isWritten ? 0 : 1;
+		}
+	}
+}
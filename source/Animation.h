@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+
+#include "Renderer.h"
+
+namespace dae
+{
+	/**
+	 * Offline rendering of a frame range at a fixed simulated time step, e.g. turntables of the rotating bunny.
+	 * The calling thread renders, finished frames get converted and written by encoder threads while the next frame renders.
+	 * At most maxFramesInFlight frames wait for the encoders, rendering blocks until one of them is written.
+	 */
+	namespace Animation
+	{
+		enum class OutputFormat
+		{
+			ImageSequence, //One binary PPM per frame in the output directory
+			Y4M, //Single raw YUV4MPEG2 4:2:0 stream, ffmpeg and most players read it directly
+		};
+
+		struct BatchRenderSettings
+		{
+			std::string sceneName{ "Scene_W4_BunnyScene" };
+			int width{ 640 };
+			int height{ 480 };
+
+			//Inclusive, frame i is rendered at scene time i * timeStep
+			int firstFrame{ 0 };
+			int lastFrame{ 119 };
+			float timeStep{ 1.f / 30.f };
+
+			bool shadowsEnabled{ true };
+			Renderer::LightingMode lightingMode{ Renderer::LightingMode::Combined };
+
+			OutputFormat format{ OutputFormat::ImageSequence };
+			//Directory for an image sequence, file for Y4M
+			std::string output{ "animation" };
+
+			int encoderThreads{ 2 };
+			//Bounds the memory of frames that are rendered but not yet on disk
+			int maxFramesInFlight{ 4 };
+		};
+
+		/**
+		 * \brief Renders frames [firstFrame, lastFrame] of the scene headless and streams them to disk
+		 * \param settings Scene, frame range, time step and output
+		 * \return 0 when every frame was written
+		 */
+		int RunBatchRender(const BatchRenderSettings& settings);
+	}
+}
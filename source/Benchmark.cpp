@@ -0,0 +1,545 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CameraPath.h"
+#include "Math.h"
+#include "Profiler.h"
+#include "RayStats.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "Timer.h"
+#include "Utils.h"
+
+namespace dae
+{
+	namespace Benchmark
+	{
+		namespace
+		{
+			struct SceneResult
+			{
+				std::string name{};
+				std::vector<double> frameTimesMs{};
+				uint64_t primaryRays{};
+				uint64_t shadowRays{};
+				RayStats::Totals statistics{};
+			};
+
+			//Nearest rank on an already sorted list
+			double GetPercentile(const std::vector<double>& sortedValues, double percentile)
+			{
+				if (sortedValues.empty())
+					return 0.0;
+
+				const size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * sortedValues.size()));
+				return sortedValues[std::clamp<size_t>(rank, 1, sortedValues.size()) - 1];
+			}
+
+			void WriteSceneBenchmarkJSON(const SceneBenchmarkSettings& settings, const std::vector<SceneResult>& results)
+			{
+				std::ofstream file(settings.outputFile);
+				file << std::fixed << std::setprecision(6);
+
+				file << "{\n";
+				file << "  \"config\": {\n";
+				file << "    \"width\": " << settings.width << ",\n";
+				file << "    \"height\": " << settings.height << ",\n";
+				file << "    \"warmupFrames\": " << settings.warmupFrames << ",\n";
+				file << "    \"frames\": " << settings.frames << ",\n";
+				file << "    \"startTime\": " << settings.startTime << ",\n";
+				file << "    \"timeStep\": " << settings.timeStep << ",\n";
+				file << "    \"shadows\": " << (settings.shadowsEnabled ? "true" : "false") << ",\n";
+				file << "    \"lightSamplesPerHit\": " << settings.lightSamplesPerHit << ",\n";
+				file << "    \"lightCutoff\": " << settings.lightCutoff << ",\n";
+				file << "    \"lightmap\": " << (settings.lightmap ? "true" : "false") << ",\n";
+				file << "    \"cameraPath\": \"" << settings.cameraPathFile << "\",\n";
+				file << "    \"threads\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef _DEBUG
+				file << "    \"build\": \"Debug\"\n";
+#else
+				file << "    \"build\": \"Release\"\n";
+#endif
+				file << "  },\n";
+
+				file << "  \"scenes\": [\n";
+				for (size_t i = 0; i < results.size(); ++i)
+				{
+					const SceneResult& result = results[i];
+
+					std::vector<double> sorted{ result.frameTimesMs };
+					std::sort(sorted.begin(), sorted.end());
+					const double totalMs = std::accumulate(sorted.begin(), sorted.end(), 0.0);
+					const double totalSeconds = std::max(totalMs / 1000.0, DBL_EPSILON);
+
+					file << "    {\n";
+					file << "      \"name\": \"" << result.name << "\",\n";
+					file << "      \"frameTimeMs\": {\n";
+					file << "        \"min\": " << (sorted.empty() ? 0.0 : sorted.front()) << ",\n";
+					file << "        \"p50\": " << GetPercentile(sorted, 50.0) << ",\n";
+					file << "        \"p90\": " << GetPercentile(sorted, 90.0) << ",\n";
+					file << "        \"p99\": " << GetPercentile(sorted, 99.0) << ",\n";
+					file << "        \"max\": " << (sorted.empty() ? 0.0 : sorted.back()) << ",\n";
+					file << "        \"mean\": " << (sorted.empty() ? 0.0 : totalMs / sorted.size()) << "\n";
+					file << "      },\n";
+					file << "      \"primaryRays\": " << result.primaryRays << ",\n";
+					file << "      \"shadowRays\": " << result.shadowRays << ",\n";
+					file << "      \"primaryMraysPerSecond\": " << result.primaryRays / totalSeconds / 1e6 << ",\n";
+					file << "      \"shadowMraysPerSecond\": " << result.shadowRays / totalSeconds / 1e6;
+#ifdef RAY_STATISTICS
+					//Summed over all measured frames
+					file << ",\n      \"statistics\": {\n";
+					for (int counter{ 0 }; counter < RayStats::CounterCount; ++counter)
+					{
+						file << "        \"" << RayStats::GetName(static_cast<RayStats::Counter>(counter)) << "\": "
+							<< result.statistics.values[counter] << (counter + 1 < RayStats::CounterCount ? "," : "") << "\n";
+					}
+					file << "      },\n";
+					//Hits per lookup, and the share of all blocked shadow rays the cache settled with a single test
+					const double occluderHits{ static_cast<double>(result.statistics.Get(RayStats::Counter::OccluderCacheHits)) };
+					const uint64_t occluderLookups{ result.statistics.Get(RayStats::Counter::OccluderCacheLookups) };
+					const uint64_t shadowHits{ result.statistics.Get(RayStats::Counter::ShadowHits) };
+					file << "      \"occluderCacheHitRate\": " << (occluderLookups == 0 ? 0.0 : occluderHits / occluderLookups) << ",\n";
+					file << "      \"occludedRaysFromCache\": " << (shadowHits == 0 ? 0.0 : occluderHits / shadowHits);
+#endif
+					file << "\n";
+					file << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+				}
+				file << "  ]\n";
+				file << "}\n";
+			}
+
+			//Grid of quads using every face syntax, a few rows use negative indices
+			bool WriteGridOBJ(const std::string& filename, unsigned int triangleCount, size_t& fileSize)
+			{
+				const unsigned int quadCount = std::max(1u, triangleCount / 2);
+				const unsigned int gridSize = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<float>(quadCount))));
+				const unsigned int vertsPerRow = gridSize + 1;
+
+				std::ofstream file(filename, std::ios::binary);
+				if (!file)
+					return false;
+
+				std::string buffer{};
+				buffer.reserve(1 << 20);
+				char line[128]{};
+
+				buffer += "# generated benchmark grid\n";
+				for (unsigned int z = 0; z < vertsPerRow; ++z)
+				{
+					for (unsigned int x = 0; x < vertsPerRow; ++x)
+					{
+						const float height = 0.1f * std::sin(x * 0.37f) * std::cos(z * 0.21f);
+						const int length = snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", x * 0.01f, height, z * 0.01f);
+						buffer.append(line, length);
+					}
+					file.write(buffer.data(), buffer.size());
+					buffer.clear();
+				}
+
+				const int vertexCount = static_cast<int>(vertsPerRow * vertsPerRow);
+				for (unsigned int z = 0; z < gridSize; ++z)
+				{
+					for (unsigned int x = 0; x < gridSize; ++x)
+					{
+						const int i0 = static_cast<int>(z * vertsPerRow + x) + 1;
+						const int i1 = i0 + 1;
+						const int i2 = i1 + static_cast<int>(vertsPerRow);
+						const int i3 = i0 + static_cast<int>(vertsPerRow);
+
+						int length{};
+						switch ((x + z) % 4)
+						{
+						case 0:
+							length = snprintf(line, sizeof(line), "f %d %d %d %d\n", i0, i1, i2, i3);
+							break;
+						case 1:
+							length = snprintf(line, sizeof(line), "f %d/%d %d/%d %d/%d %d/%d\n", i0, i0, i1, i1, i2, i2, i3, i3);
+							break;
+						case 2:
+							length = snprintf(line, sizeof(line), "f %d//%d %d//%d %d//%d %d//%d\n", i0, i0, i1, i1, i2, i2, i3, i3);
+							break;
+						case 3:
+							length = snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\nf %d %d %d\n",
+								i0, i0, i0, i1, i1, i1, i2, i2, i2,
+								i0 - vertexCount - 1, i2 - vertexCount - 1, i3 - vertexCount - 1);
+							break;
+						}
+						buffer.append(line, length);
+					}
+					file.write(buffer.data(), buffer.size());
+					buffer.clear();
+				}
+
+				fileSize = static_cast<size_t>(file.tellp());
+				return true;
+			}
+
+			//Keeps the timed loops from being optimized away
+			volatile unsigned int g_HitSink{};
+
+			/**
+			 * Candidate rays aimed at the bounds get classified with doesHit, then hits and misses are picked
+			 * evenly from both groups to get the requested hit rate.
+			 * Coherent: one pinhole camera, rays in scanline order. Incoherent: origins all around the bounds, shuffled.
+			 */
+			std::vector<Ray> GenerateRays(const Vector3& boundsMin, const Vector3& boundsMax, bool isCoherent, float hitRate, unsigned int rayCount,
+				unsigned int seed, const std::function<bool(const Ray&)>& doesHit, float& actualHitRate)
+			{
+				const Vector3 center{ (boundsMin + boundsMax) * 0.5f };
+				const float radius{ std::max((boundsMax - boundsMin).Magnitude() * 0.5f, 0.5f) };
+
+				std::mt19937 random{ seed };
+				std::uniform_real_distribution<float> distribution{ -1.f, 1.f };
+
+				const unsigned int candidateCount{ rayCount * 2 };
+				const unsigned int gridSize{ static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<float>(candidateCount)))) };
+				const Vector3 cameraOrigin{ center + Vector3{ 0.f, radius, -3.f * radius } };
+
+				std::vector<Ray> candidates{};
+				std::vector<unsigned int> hitIndices{};
+				std::vector<unsigned int> missIndices{};
+				candidates.reserve(candidateCount);
+
+				for (unsigned int i{ 0 }; i < candidateCount; ++i)
+				{
+					Vector3 origin{};
+					Vector3 target{};
+					if (isCoherent)
+					{
+						const float x{ ((i % gridSize) + 0.5f) / gridSize * 2.f - 1.f };
+						const float y{ 1.f - ((i / gridSize) + 0.5f) / gridSize * 2.f };
+
+						origin = cameraOrigin;
+						target = center + Vector3{ x, y, 0.f } * (1.5f * radius);
+					}
+					else
+					{
+						Vector3 direction{};
+						do
+						{
+							direction = { distribution(random), distribution(random), distribution(random) };
+						} while (direction.SqrMagnitude() > 1.f || direction.SqrMagnitude() < 0.01f);
+
+						origin = center + direction.Normalized() * (3.f * radius);
+						target = center + Vector3{ distribution(random), distribution(random), distribution(random) } * radius;
+					}
+
+					const Ray ray{ origin, (target - origin).Normalized() };
+					(doesHit(ray) ? hitIndices : missIndices).push_back(i);
+					candidates.push_back(ray);
+				}
+
+				//Can't fill a group that never occurs, e.g. misses on a plane seen from above
+				unsigned int hitCount{ static_cast<unsigned int>(std::lround(std::clamp(hitRate, 0.f, 1.f) * rayCount)) };
+				if (hitIndices.empty())
+					hitCount = 0;
+				else if (missIndices.empty())
+					hitCount = rayCount;
+
+				std::vector<unsigned int> selected{};
+				selected.reserve(rayCount);
+				for (unsigned int i{ 0 }; i < hitCount; ++i)
+					selected.push_back(hitIndices[static_cast<size_t>(i) * hitIndices.size() / hitCount]);
+				for (unsigned int i{ 0 }; i < rayCount - hitCount; ++i)
+					selected.push_back(missIndices[static_cast<size_t>(i) * missIndices.size() / (rayCount - hitCount)]);
+
+				if (isCoherent)
+					std::sort(selected.begin(), selected.end());
+				else
+					std::shuffle(selected.begin(), selected.end(), random);
+
+				std::vector<Ray> rays{};
+				rays.reserve(rayCount);
+				for (const unsigned int index : selected)
+					rays.push_back(candidates[index]);
+
+				actualHitRate = static_cast<float>(hitCount) / rayCount;
+				return rays;
+			}
+
+			template<typename Kernel>
+			void RunIntersectionKernel(const IntersectionBenchmarkSettings& settings, const std::string& name, const Vector3& boundsMin, const Vector3& boundsMax,
+				unsigned int rayCount, const Kernel& kernel)
+			{
+				for (const bool isCoherent : { true, false })
+				{
+					for (const float hitRate : settings.hitRates)
+					{
+						float actualHitRate{};
+						const std::vector<Ray> rays{ GenerateRays(boundsMin, boundsMax, isCoherent, hitRate, rayCount, settings.seed, kernel, actualHitRate) };
+
+						double bestSeconds{ DBL_MAX };
+						for (int run = 0; run < settings.numRuns; ++run)
+						{
+							unsigned int hits{};
+							const auto start = std::chrono::steady_clock::now();
+							for (const Ray& ray : rays)
+								hits += kernel(ray) ? 1 : 0;
+							const auto end = std::chrono::steady_clock::now();
+
+							g_HitSink = g_HitSink + hits;
+							bestSeconds = std::min(bestSeconds, std::chrono::duration<double>(end - start).count());
+						}
+						bestSeconds = std::max(bestSeconds, DBL_EPSILON);
+
+						std::cout << std::left << std::setw(36) << name
+							<< std::setw(12) << (isCoherent ? "coherent" : "incoherent")
+							<< std::right << std::setw(8) << rayCount
+							<< std::setw(8) << std::lround(actualHitRate * 100.f) << "%"
+							<< std::setw(12) << bestSeconds * 1e9 / rayCount
+							<< std::setw(12) << rayCount / bestSeconds / 1e6 << "\n";
+					}
+				}
+			}
+
+			//Bumpy grid in the XY plane spanning [-1, 1]
+			TriangleMesh CreateGridMesh(unsigned int triangleCount)
+			{
+				const unsigned int gridSize{ std::max(1u, static_cast<unsigned int>(std::ceil(std::sqrt(triangleCount / 2.f)))) };
+				const unsigned int vertsPerRow{ gridSize + 1 };
+
+				std::vector<Vector3> positions{};
+				std::vector<int> indices{};
+				positions.reserve(static_cast<size_t>(vertsPerRow) * vertsPerRow);
+				indices.reserve(static_cast<size_t>(gridSize) * gridSize * 6);
+
+				for (unsigned int y = 0; y < vertsPerRow; ++y)
+				{
+					for (unsigned int x = 0; x < vertsPerRow; ++x)
+					{
+						const float px{ static_cast<float>(x) / gridSize * 2.f - 1.f };
+						const float py{ static_cast<float>(y) / gridSize * 2.f - 1.f };
+						positions.emplace_back(px, py, 0.1f * std::sin(px * 7.f) * std::cos(py * 5.f));
+					}
+				}
+
+				for (unsigned int y = 0; y < gridSize; ++y)
+				{
+					for (unsigned int x = 0; x < gridSize; ++x)
+					{
+						const int i0{ static_cast<int>(y * vertsPerRow + x) };
+						const int i1{ i0 + 1 };
+						const int i2{ i1 + static_cast<int>(vertsPerRow) };
+						const int i3{ i0 + static_cast<int>(vertsPerRow) };
+
+						indices.insert(indices.end(), { i0, i1, i2, i0, i2, i3 });
+					}
+				}
+
+				//The constructor only transforms, the box the slab test reads has to be computed first
+				TriangleMesh mesh{ positions, indices, TriangleCullMode::NoCulling };
+				mesh.UpdateAABB();
+				mesh.UpdateTransforms();
+				return mesh;
+			}
+		}
+
+		void RunOBJParseBenchmark(unsigned int triangleCount, int numRuns)
+		{
+			const std::string filename{ "benchmark_grid.obj" };
+
+			std::cout << "**OBJ BENCHMARK** generating ~" << triangleCount << " triangles...\n";
+			size_t fileSize{};
+			if (!WriteGridOBJ(filename, triangleCount, fileSize))
+			{
+				std::cout << "Could not write " << filename << std::endl;
+				return;
+			}
+
+			std::vector<Vector3> positions{};
+			std::vector<Vector3> normals{};
+			std::vector<int> indices{};
+
+			double bestSeconds{ DBL_MAX };
+			for (int run = 0; run < numRuns; ++run)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				const bool success = Utils::ParseOBJ(filename, positions, normals, indices);
+				const auto end = std::chrono::steady_clock::now();
+
+				if (!success)
+				{
+					std::cout << "ParseOBJ failed" << std::endl;
+					break;
+				}
+				bestSeconds = std::min(bestSeconds, std::chrono::duration<double>(end - start).count());
+			}
+
+			const double megaBytes = static_cast<double>(fileSize) / (1024.0 * 1024.0);
+			std::cout << ">> FILE = " << megaBytes << " MB" << std::endl;
+			std::cout << ">> VERTICES = " << positions.size() << std::endl;
+			std::cout << ">> TRIANGLES = " << indices.size() / 3 << std::endl;
+			std::cout << ">> BEST = " << bestSeconds * 1000.0 << " ms" << std::endl;
+			std::cout << ">> THROUGHPUT = " << megaBytes / bestSeconds << " MB/s" << std::endl;
+
+			std::remove(filename.c_str());
+		}
+
+		void RunSceneBenchmark(const SceneBenchmarkSettings& benchmarkSettings)
+		{
+			CameraPath cameraPath{};
+			if (!benchmarkSettings.cameraPathFile.empty() && !cameraPath.Load(benchmarkSettings.cameraPathFile))
+			{
+				std::cout << "Could not load camera path " << benchmarkSettings.cameraPathFile << std::endl;
+				return;
+			}
+			const bool hasCameraPath{ !cameraPath.GetKeyframes().empty() };
+
+			SceneBenchmarkSettings settings{ benchmarkSettings };
+			if (hasCameraPath)
+				settings.frames = static_cast<int>(cameraPath.GetKeyframes().size());
+
+			std::cout << "**SCENE BENCHMARK STARTED** " << settings.width << "x" << settings.height
+				<< ", " << settings.frames << " frames per scene\n";
+
+			if (!settings.traceFile.empty())
+				Profiler::BeginCapture();
+
+			Renderer renderer{ settings.width, settings.height };
+			if (!renderer.IsValid())
+				return;
+			renderer.SetShadowsEnabled(settings.shadowsEnabled);
+			if (settings.lightSamplesPerHit > 0)
+			{
+				renderer.SetLightSampling(Renderer::LightSampling::Importance);
+				renderer.SetLightSamplesPerHit(settings.lightSamplesPerHit);
+			}
+			renderer.SetLightCutoff(settings.lightCutoff);
+
+			std::vector<SceneResult> results{};
+			for (const SceneFactory& factory : GetSceneFactories())
+			{
+				if (hasCameraPath ? cameraPath.GetSceneName() != factory.name
+					: !settings.sceneFilter.empty() && std::string(factory.name).find(settings.sceneFilter) == std::string::npos)
+					continue;
+
+				const std::unique_ptr<Scene> pScene = factory.create();
+				pScene->Initialize();
+				if (settings.lightmap)
+					renderer.BakeLightmap(pScene.get());
+
+				//Never started, so only the simulated time is ever seen by the scene
+				Timer timer{};
+
+				SceneResult result{};
+				result.name = factory.name;
+				result.frameTimesMs.reserve(settings.frames);
+
+				for (int frame = -settings.warmupFrames; frame < settings.frames; ++frame)
+				{
+					const int simulatedFrame = std::max(frame, 0);
+					if (hasCameraPath)
+					{
+						const CameraKeyframe& keyframe{ cameraPath.GetKeyframes()[simulatedFrame] };
+						timer.SetSimulatedTime(keyframe.totalTime, keyframe.elapsedTime);
+					}
+					else
+						timer.SetSimulatedTime(settings.startTime + simulatedFrame * settings.timeStep, settings.timeStep);
+
+					const auto start = std::chrono::steady_clock::now();
+					{
+						PROFILE_ZONE("Frame");
+						{
+							PROFILE_ZONE("Scene::Update");
+							pScene->Update(&timer);
+						}
+						//Overrides whatever input the camera picked up
+						if (hasCameraPath)
+							cameraPath.ApplyKeyframe(simulatedFrame, pScene->GetCamera());
+
+						renderer.Render(pScene.get());
+					}
+					const auto end = std::chrono::steady_clock::now();
+
+					if (frame < 0)
+						continue;
+
+					result.frameTimesMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+					result.primaryRays += renderer.GetPrimaryRayCount();
+					result.shadowRays += renderer.GetShadowRayCount();
+					result.statistics += RayStats::GetFrameTotals();
+				}
+
+				const double avgMs = std::accumulate(result.frameTimesMs.begin(), result.frameTimesMs.end(), 0.0) / std::max(1, settings.frames);
+				std::cout << ">> " << result.name << " AVG = " << avgMs << " ms" << std::endl;
+
+				results.push_back(std::move(result));
+			}
+
+			WriteSceneBenchmarkJSON(settings, results);
+			std::cout << "**SCENE BENCHMARK FINISHED** results written to " << settings.outputFile << std::endl;
+
+			if (!settings.traceFile.empty())
+			{
+				if (Profiler::EndCapture(settings.traceFile))
+					std::cout << "Trace written to " << settings.traceFile << std::endl;
+				else
+					std::cout << "Failed to write trace " << settings.traceFile << std::endl;
+			}
+		}
+
+		void RunIntersectionBenchmark(const IntersectionBenchmarkSettings& settings)
+		{
+			std::cout << "**INTERSECTION BENCHMARK STARTED** single threaded, best of " << settings.numRuns << " runs\n";
+			std::cout << std::fixed << std::setprecision(2);
+			std::cout << std::left << std::setw(36) << "KERNEL" << std::setw(12) << "RAYS"
+				<< std::right << std::setw(8) << "COUNT" << std::setw(9) << "HITS"
+				<< std::setw(12) << "NS/RAY" << std::setw(12) << "MRAYS/S" << "\n";
+
+			const Sphere sphere{ { 0.f, 0.f, 0.f }, 1.f };
+			RunIntersectionKernel(settings, "HitTest_Sphere", { -1.f, -1.f, -1.f }, { 1.f, 1.f, 1.f }, settings.rayCount,
+				[&sphere](const Ray& ray) { float t{}; return GeometryUtils::HitTest_Sphere(sphere, ray, t); });
+
+			const Plane plane{ { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } };
+			RunIntersectionKernel(settings, "HitTest_Plane", { -1.f, 0.f, -1.f }, { 1.f, 0.f, 1.f }, settings.rayCount,
+				[&plane](const Ray& ray) { float t{}; return GeometryUtils::HitTest_Plane(plane, ray, t); });
+
+			//Moller-Trumbore is what HitTest_Triangle runs, culling off so both sides count
+			const Triangle triangle{ { -1.f, -1.f, 0.f }, { 0.f, 1.f, 0.f }, { 1.f, -1.f, 0.f } };
+			RunIntersectionKernel(settings, "HitTest_Triangle", { -1.f, -1.f, 0.f }, { 1.f, 1.f, 0.f }, settings.rayCount,
+				[&triangle](const Ray& ray)
+				{
+					float t{}, u{}, v{};
+					return GeometryUtils::HitTest_Triangle(triangle.v0, triangle.v1, triangle.v2, TriangleCullMode::NoCulling, triangle.normal, ray, t, u, v);
+				});
+
+			const Vector3 boxMin{ -1.f, -1.f, -1.f };
+			const Vector3 boxMax{ 1.f, 1.f, 1.f };
+			RunIntersectionKernel(settings, "HitTest_SlabTest", boxMin, boxMax, settings.rayCount,
+				[&boxMin, &boxMax](const Ray& ray) { return GeometryUtils::HitTest_SlabTest(boxMin, boxMax, ray); });
+
+			//Roughly the same amount of triangle tests for every mesh size
+			constexpr uint64_t triangleTestBudget{ 1ull << 23 };
+			const Vector3 meshMin{ -1.f, -1.f, -0.1f };
+			const Vector3 meshMax{ 1.f, 1.f, 0.1f };
+			for (const unsigned int triangleCount : settings.meshTriangleCounts)
+			{
+				const TriangleMesh mesh{ CreateGridMesh(triangleCount) };
+				const unsigned int meshTriangles{ static_cast<unsigned int>(mesh.indices.size() / 3) };
+				const unsigned int rayCount{ static_cast<unsigned int>(std::clamp<uint64_t>(triangleTestBudget / meshTriangles, std::min<uint64_t>(1024, settings.rayCount), settings.rayCount)) };
+				const std::string suffix{ " (" + std::to_string(meshTriangles) + " tris)" };
+
+				RunIntersectionKernel(settings, "TriangleMesh closest" + suffix, meshMin, meshMax, rayCount,
+					[&mesh](const Ray& ray) { HitCandidate candidate{}; return GeometryUtils::HitTest_TriangleMesh(mesh, ray, candidate); });
+				RunIntersectionKernel(settings, "TriangleMesh any" + suffix, meshMin, meshMax, rayCount,
+					[&mesh](const Ray& ray) { return GeometryUtils::HitTest_TriangleMesh(mesh, ray); });
+			}
+
+			std::cout << "**INTERSECTION BENCHMARK FINISHED**" << std::endl;
+		}
+	}
+}
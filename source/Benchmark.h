@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	namespace Benchmark
+	{
+		struct SceneBenchmarkSettings
+		{
+			int width{ 640 };
+			int height{ 480 };
+
+			int warmupFrames{ 2 };
+			int frames{ 30 };
+
+			//Scene time of frame i is startTime + i * timeStep, independent of how long rendering takes
+			float startTime{ 0.f };
+			float timeStep{ 1.f / 30.f };
+
+			bool shadowsEnabled{ true };
+			//Importance sampled lights per hit, 0 shades every hit with all lights
+			int lightSamplesPerHit{ 0 };
+			//Radiance below which a light stops reaching a point, 0 lets every light reach everywhere
+			float lightCutoff{ 0.f };
+			//Bakes the static planes of every scene before its first frame
+			bool lightmap{ false };
+
+			//Only scenes whose name contains this, empty runs all of them
+			std::string sceneFilter{};
+			std::string outputFile{ "benchmark.json" };
+			//Chrome trace of the whole run, empty disables the profiler
+			std::string traceFile{};
+			//Replays a recorded CameraPath instead, only its scene runs and frames becomes the path length
+			std::string cameraPathFile{};
+		};
+
+		struct IntersectionBenchmarkSettings
+		{
+			//Per ray set, mesh sets get fewer rays so every set costs about the same
+			unsigned int rayCount{ 1 << 20 };
+			int numRuns{ 5 };
+
+			//Same seed, same rays
+			unsigned int seed{ 1337 };
+
+			std::vector<float> hitRates{ 0.1f, 0.5f, 0.9f };
+			std::vector<unsigned int> meshTriangleCounts{ 32, 1024, 16384 };
+		};
+
+		/**
+		 * \brief Renders every built-in scene headless and writes frame time percentiles and ray throughput as JSON
+		 * \param settings Resolution, frame count and simulated time for every scene
+		 */
+		void RunSceneBenchmark(const SceneBenchmarkSettings& settings);
+
+		/**
+		 * \brief Writes a generated grid mesh to disk and measures Utils::ParseOBJ throughput
+		 * \param triangleCount Approximate number of triangles in the generated file
+		 * \param numRuns Number of timed parses, the fastest one is reported
+		 */
+		void RunOBJParseBenchmark(unsigned int triangleCount = 4'000'000, int numRuns = 5);
+
+		/**
+		 * \brief Times the GeometryUtils hit tests in isolation on generated ray sets and prints ns/ray and Mrays/s
+		 * \param settings Ray count, hit rates and mesh sizes to test, every kernel runs coherent and incoherent rays
+		 */
+		void RunIntersectionBenchmark(const IntersectionBenchmarkSettings& settings);
+	}
+}
@@ -0,0 +1,88 @@
+#include "CameraPath.h"
+
+#include <cstring>
+#include <fstream>
+
+#include "Camera.h"
+#include "Timer.h"
+
+namespace dae
+{
+	static_assert(sizeof(CameraKeyframe) == 9 * sizeof(float), "Keyframes are written as raw floats");
+
+	namespace
+	{
+		//Far beyond anything recorded, a header asking for more is corrupt
+		constexpr uint32_t MaxNameLength{ 1024 };
+		constexpr uint32_t MaxFrameCount{ 1u << 22 };
+	}
+
+	void CameraPath::Clear()
+	{
+		m_Keyframes.clear();
+	}
+
+	void CameraPath::AddKeyframe(const Camera& camera, const Timer& timer)
+	{
+		m_Keyframes.push_back({ camera.origin, camera.forward, camera.fovAngle, timer.GetTotal(), timer.GetElapsed() });
+	}
+
+	void CameraPath::ApplyKeyframe(size_t index, Camera& camera) const
+	{
+		const CameraKeyframe& keyframe{ m_Keyframes[index] };
+
+		camera.origin = keyframe.origin;
+		camera.forward = keyframe.forward;
+		camera.SetFovAngle(keyframe.fovAngle);
+	}
+
+	bool CameraPath::Save(const std::string& filename) const
+	{
+		std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		Header header{};
+		header.version = Version;
+		header.nameLength = static_cast<uint32_t>(m_SceneName.size());
+		header.frameCount = static_cast<uint32_t>(m_Keyframes.size());
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		file.write(m_SceneName.data(), m_SceneName.size());
+		file.write(reinterpret_cast<const char*>(m_Keyframes.data()), static_cast<std::streamsize>(m_Keyframes.size() * sizeof(CameraKeyframe)));
+		return static_cast<bool>(file);
+	}
+
+	bool CameraPath::Load(const std::string& filename)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		if (!file)
+			return false;
+
+		Header header{};
+		file.read(reinterpret_cast<char*>(&header), sizeof(Header));
+		if (!file || std::memcmp(header.magic, Header{}.magic, sizeof(header.magic)) != 0 || header.version != Version)
+			return false;
+
+		//Sizes come from the file, check them against what's actually in it before allocating anything
+		const std::streampos dataStart{ file.tellg() };
+		file.seekg(0, std::ios::end);
+		const uint64_t remainingSize{ static_cast<uint64_t>(file.tellg() - dataStart) };
+		file.seekg(dataStart);
+		if (!file || header.nameLength > MaxNameLength || header.frameCount > MaxFrameCount
+			|| header.nameLength + uint64_t{ header.frameCount } * sizeof(CameraKeyframe) > remainingSize)
+			return false;
+
+		m_SceneName.resize(header.nameLength);
+		file.read(m_SceneName.data(), header.nameLength);
+
+		m_Keyframes.resize(header.frameCount);
+		file.read(reinterpret_cast<char*>(m_Keyframes.data()), static_cast<std::streamsize>(m_Keyframes.size() * sizeof(CameraKeyframe)));
+		if (!file)
+		{
+			Clear();
+			return false;
+		}
+		return true;
+	}
+}
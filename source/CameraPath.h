@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	struct Camera;
+	class Timer;
+
+	//Everything needed to put a camera back where it was, plus the scene time of that frame
+	struct CameraKeyframe
+	{
+		Vector3 origin{};
+		Vector3 forward{};
+		float fovAngle{};
+
+		float totalTime{};
+		float elapsedTime{};
+	};
+
+	//Per frame camera recording of an interactive session, replayed headless by the benchmark
+	class CameraPath final
+	{
+	public:
+		//Binary layout: header, scene name (nameLength chars), frameCount CameraKeyframes
+		struct Header
+		{
+			char magic[4]{ 'R', 'T', 'C', 'P' };
+			uint32_t version{};
+			uint32_t nameLength{};
+			uint32_t frameCount{};
+		};
+
+		static constexpr uint32_t Version{ 1 };
+
+		void Clear();
+		void AddKeyframe(const Camera& camera, const Timer& timer);
+		//Restores origin, forward and FOV of a recorded frame
+		void ApplyKeyframe(size_t index, Camera& camera) const;
+
+		bool Save(const std::string& filename) const;
+		bool Load(const std::string& filename);
+
+		void SetSceneName(const std::string& sceneName) { m_SceneName = sceneName; }
+		const std::string& GetSceneName() const { return m_SceneName; }
+		const std::vector<CameraKeyframe>& GetKeyframes() const { return m_Keyframes; }
+
+	private:
+		std::string m_SceneName{};
+		std::vector<CameraKeyframe> m_Keyframes{};
+	};
+}
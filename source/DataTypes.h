@@ -1,7 +1,10 @@
 #pragma once
 #include <cassert>
 
+#include <memory>
+
 #include "Math.h"
+#include "Profiler.h"
 #include "vector"
 
 namespace dae
@@ -150,6 +153,8 @@ namespace dae
 
 		void UpdateTransforms()
 		{
+			PROFILE_ZONE("TriangleMesh::UpdateTransforms");
+
 			//Calculate Final Transform 
 			//const auto finalTransform = ...
 
@@ -192,7 +197,7 @@ namespace dae
 				for (auto& p : positions)
 				{
 					minAABB = Vector3::Min(p, minAABB);
-					maxAABB = Vector3::Min(p, maxAABB);
+					maxAABB = Vector3::Max(p, maxAABB);
 				}
 			}
 		}
@@ -237,6 +242,97 @@ namespace dae
 			transformedMaxAABB = tMaxAABB;
 		}
 	};
+
+	//Geometry that can be shared by any number of TriangleMeshInstances, stays in object space
+	struct MeshData
+	{
+		MeshData() = default;
+		MeshData(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals) :
+			positions(_positions), normals(_normals), indices(_indices)
+		{
+			UpdateAABB();
+		}
+
+		std::vector<Vector3> positions{};
+		std::vector<Vector3> normals{};
+		std::vector<int> indices{};
+
+		Vector3 minAABB{};
+		Vector3 maxAABB{};
+
+		void UpdateAABB()
+		{
+			if (positions.empty())
+				return;
+
+			minAABB = positions[0];
+			maxAABB = positions[0];
+			for (const auto& p : positions)
+			{
+				minAABB = Vector3::Min(p, minAABB);
+				maxAABB = Vector3::Max(p, maxAABB);
+			}
+		}
+	};
+
+	//Placement of shared MeshData, rays get transformed into object space instead of copying the vertices
+	struct TriangleMeshInstance
+	{
+		std::shared_ptr<const MeshData> pMeshData{};
+
+		unsigned char materialIndex{};
+		TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
+
+		Matrix rotationTransform{};
+		Matrix translationTransform{};
+		Matrix scaleTransform{};
+
+		Matrix worldTransform{};
+		Matrix inverseWorldTransform{};
+
+		Vector3 transformedMinAABB{};
+		Vector3 transformedMaxAABB{};
+
+		void Translate(const Vector3& translation)
+		{
+			translationTransform = Matrix::CreateTranslation(translation);
+		}
+
+		void RotateY(float yaw)
+		{
+			rotationTransform = Matrix::CreateRotationY(yaw);
+		}
+
+		void Scale(const Vector3& scale)
+		{
+			scaleTransform = Matrix::CreateScale(scale);
+		}
+
+		void UpdateTransforms()
+		{
+			PROFILE_ZONE("TriangleMeshInstance::UpdateTransforms");
+
+			worldTransform = scaleTransform * rotationTransform * translationTransform;
+			inverseWorldTransform = Matrix::Inverse(worldTransform);
+
+			//World AABB around all 8 transformed corners
+			const Vector3& minAABB = pMeshData->minAABB;
+			const Vector3& maxAABB = pMeshData->maxAABB;
+
+			transformedMinAABB = worldTransform.TransformPoint(minAABB);
+			transformedMaxAABB = transformedMinAABB;
+			for (int corner{ 1 }; corner < 8; ++corner)
+			{
+				const Vector3 tAABB = worldTransform.TransformPoint(
+					(corner & 1) ? maxAABB.x : minAABB.x,
+					(corner & 2) ? maxAABB.y : minAABB.y,
+					(corner & 4) ? maxAABB.z : minAABB.z);
+
+				transformedMinAABB = Vector3::Min(tAABB, transformedMinAABB);
+				transformedMaxAABB = Vector3::Max(tAABB, transformedMaxAABB);
+			}
+		}
+	};
 #pragma endregion
 #pragma region LIGHT
 	enum class LightType
@@ -265,6 +361,15 @@ namespace dae
 		float max{ FLT_MAX };
 	};
 
+	enum class PrimitiveType : unsigned char
+	{
+		None,
+		Sphere,
+		Plane,
+		TriangleMesh,
+		TriangleMeshInstance
+	};
+
 	struct HitRecord
 	{
 		Vector3 origin{};
@@ -273,6 +378,24 @@ namespace dae
 
 		bool didHit{ false };
 		unsigned char materialIndex{ 0 };
+
+		//What was hit, only filled in by Scene
+		PrimitiveType primitiveType{ PrimitiveType::None };
+		unsigned int primitiveIndex{};
+	};
+
+	//Only what traversal needs, origin/normal/material get reconstructed once for the closest hit
+	struct HitCandidate
+	{
+		float t = FLT_MAX;
+
+		//Barycentrics, only used by triangles
+		float u{};
+		float v{};
+
+		unsigned int primitiveIndex{};
+		unsigned int triangleIndex{};
+		PrimitiveType primitiveType{ PrimitiveType::None };
 	};
 #pragma endregion
 }
\ No newline at end of file
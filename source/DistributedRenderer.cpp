@@ -0,0 +1,506 @@
+#include "DistributedRenderer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Profiler.h"
+#include "Scene.h"
+#include "Socket.h"
+#include "Timer.h"
+
+namespace dae
+{
+	namespace Distributed
+	{
+		namespace
+		{
+			enum class MessageType : uint32_t
+			{
+				Job = 1, //Coordinator > worker: JobMessage
+				Tile, //Coordinator > worker: TileMessage
+				TileResult, //Worker > coordinator: TileResultMessage + RGB bytes
+				Quit, //Coordinator > worker, no payload
+			};
+
+			struct MessageHeader
+			{
+				char magic[4]{ 'R', 'T', 'D', 'R' };
+				MessageType type{};
+				uint32_t payloadSize{};
+			};
+
+			struct JobMessage
+			{
+				int32_t width{};
+				int32_t height{};
+				float time{};
+				uint32_t shadowsEnabled{};
+				uint32_t lightingMode{};
+				uint32_t primaryVisibility{};
+				uint32_t lightSampling{};
+				int32_t lightSamplesPerHit{};
+				float lightCutoff{};
+				uint32_t lightmap{};
+				char sceneName[64]{};
+			};
+
+			struct TileMessage
+			{
+				int32_t tileIndex{};
+			};
+
+			struct TileResultMessage
+			{
+				int32_t tileIndex{};
+				int32_t x{};
+				int32_t y{};
+				int32_t width{};
+				int32_t height{};
+			};
+
+			bool SendPacket(const TcpSocket& socket, MessageType type, const void* pPayload = nullptr, size_t payloadSize = 0,
+				const void* pExtra = nullptr, size_t extraSize = 0)
+			{
+				MessageHeader header{};
+				header.type = type;
+				header.payloadSize = static_cast<uint32_t>(payloadSize + extraSize);
+
+				return socket.SendAll(&header, sizeof(header))
+					&& (payloadSize == 0 || socket.SendAll(pPayload, payloadSize))
+					&& (extraSize == 0 || socket.SendAll(pExtra, extraSize));
+			}
+
+			bool ReceiveHeader(const TcpSocket& socket, MessageHeader& header)
+			{
+				return socket.ReceiveAll(&header, sizeof(header)) && std::memcmp(header.magic, MessageHeader{}.magic, sizeof(header.magic)) == 0;
+			}
+
+			//Pending tiles first, then tiles that have been out for too long, -1 once every tile arrived
+			class TileScheduler final
+			{
+			public:
+				TileScheduler(int tileCount, float stragglerTimeout) :
+					m_States(tileCount, State::Pending),
+					m_IssueTimes(tileCount),
+					m_StragglerTimeout(std::chrono::duration<float>(stragglerTimeout)),
+					m_RemainingCount(tileCount)
+				{
+					for (int i{ 0 }; i < tileCount; ++i)
+						m_Pending.push_back(i);
+				}
+
+				int Acquire()
+				{
+					std::unique_lock<std::mutex> lock{ m_Mutex };
+					while (m_RemainingCount > 0)
+					{
+						const auto now = std::chrono::steady_clock::now();
+						if (!m_Pending.empty())
+						{
+							const int tileIndex{ m_Pending.front() };
+							m_Pending.pop_front();
+							m_States[tileIndex] = State::InFlight;
+							m_IssueTimes[tileIndex] = now;
+							return tileIndex;
+						}
+
+						//Oldest straggler goes out again, whoever finishes first wins
+						int oldestIndex{ -1 };
+						for (int i{ 0 }; i < static_cast<int>(m_States.size()); ++i)
+						{
+							if (m_States[i] == State::InFlight && (oldestIndex < 0 || m_IssueTimes[i] < m_IssueTimes[oldestIndex]))
+								oldestIndex = i;
+						}
+						if (oldestIndex >= 0 && now - m_IssueTimes[oldestIndex] >= m_StragglerTimeout)
+						{
+							m_IssueTimes[oldestIndex] = now;
+							++m_ReissuedCount;
+							return oldestIndex;
+						}
+
+						m_Condition.wait_for(lock, std::chrono::milliseconds(10));
+					}
+					return -1;
+				}
+
+				//True for the first result of a tile, later copies get dropped
+				bool Complete(int tileIndex)
+				{
+					const std::lock_guard<std::mutex> lock{ m_Mutex };
+					if (m_States[tileIndex] == State::Done)
+						return false;
+
+					m_States[tileIndex] = State::Done;
+					--m_RemainingCount;
+					m_Condition.notify_all();
+					return true;
+				}
+
+				//The worker is gone, somebody else has to do it
+				void Release(int tileIndex)
+				{
+					const std::lock_guard<std::mutex> lock{ m_Mutex };
+					if (m_States[tileIndex] != State::InFlight)
+						return;
+
+					m_States[tileIndex] = State::Pending;
+					m_Pending.push_front(tileIndex);
+					m_Condition.notify_all();
+				}
+
+				void AddWorker()
+				{
+					const std::lock_guard<std::mutex> lock{ m_Mutex };
+					++m_WorkerCount;
+				}
+
+				void RemoveWorker()
+				{
+					const std::lock_guard<std::mutex> lock{ m_Mutex };
+					--m_WorkerCount;
+					m_Condition.notify_all();
+				}
+
+				//Returns once every tile arrived or every worker is gone
+				void WaitUntilDone()
+				{
+					std::unique_lock<std::mutex> lock{ m_Mutex };
+					m_Condition.wait(lock, [this] { return m_RemainingCount == 0 || m_WorkerCount == 0; });
+				}
+
+				int GetRemainingCount() const
+				{
+					const std::lock_guard<std::mutex> lock{ m_Mutex };
+					return m_RemainingCount;
+				}
+
+				int GetReissuedCount() const
+				{
+					const std::lock_guard<std::mutex> lock{ m_Mutex };
+					return m_ReissuedCount;
+				}
+
+			private:
+				enum class State : unsigned char
+				{
+					Pending,
+					InFlight,
+					Done,
+				};
+
+				mutable std::mutex m_Mutex{};
+				std::condition_variable m_Condition{};
+
+				std::deque<int> m_Pending{};
+				std::vector<State> m_States{};
+				std::vector<std::chrono::steady_clock::time_point> m_IssueTimes{};
+				std::chrono::duration<float> m_StragglerTimeout{};
+
+				int m_RemainingCount{};
+				int m_ReissuedCount{};
+				int m_WorkerCount{};
+			};
+
+			//Sends the job, then hands this worker tiles until there are none left or it stops answering
+			void DriveWorker(const TcpSocket& socket, const JobMessage& job, TileScheduler& scheduler, std::vector<uint8_t>& image, int& renderedTileCount)
+			{
+				if (!SendPacket(socket, MessageType::Job, &job, sizeof(job)))
+					return;
+
+				std::vector<uint8_t> pixels{};
+				for (int tileIndex{ scheduler.Acquire() }; tileIndex >= 0; tileIndex = scheduler.Acquire())
+				{
+					const TileMessage request{ tileIndex };
+					MessageHeader header{};
+					TileResultMessage result{};
+
+					const bool isReceived{ SendPacket(socket, MessageType::Tile, &request, sizeof(request))
+						&& ReceiveHeader(socket, header) && header.type == MessageType::TileResult && header.payloadSize >= sizeof(result)
+						&& socket.ReceiveAll(&result, sizeof(result)) };
+
+					const bool isValid{ isReceived && result.tileIndex == tileIndex
+						&& result.x >= 0 && result.y >= 0 && result.width > 0 && result.height > 0
+						&& result.x + result.width <= job.width && result.y + result.height <= job.height
+						&& header.payloadSize - sizeof(result) == static_cast<size_t>(result.width) * result.height * 3 };
+
+					if (isValid)
+						pixels.resize(header.payloadSize - sizeof(result));
+
+					if (!isValid || !socket.ReceiveAll(pixels.data(), pixels.size()))
+					{
+						//Stragglers get cut off once everything is in, that's not worth a message
+						if (scheduler.GetRemainingCount() > 0)
+							std::cout << "Worker dropped out, tile " << tileIndex << " goes back in the queue" << std::endl;
+						scheduler.Release(tileIndex);
+						return;
+					}
+
+					//Tiles don't overlap and only the first copy gets written, no lock needed
+					if (!scheduler.Complete(tileIndex))
+						continue;
+
+					for (int row{ 0 }; row < result.height; ++row)
+					{
+						std::memcpy(&image[(static_cast<size_t>(result.y + row) * job.width + result.x) * 3],
+							&pixels[static_cast<size_t>(row) * result.width * 3], static_cast<size_t>(result.width) * 3);
+					}
+					++renderedTileCount;
+				}
+			}
+
+			void LaunchLocalWorker(const std::string& executable, uint16_t port)
+			{
+				std::string command{ "\"" + executable + "\" --worker 127.0.0.1 " + std::to_string(port) };
+#ifdef _WIN32
+				//cmd strips the outer quotes
+				command = "\"" + command + "\"";
+#endif
+				//std::system blocks until the worker exits, every worker gets its own thread
+				std::thread([command] { std::system(command.c_str()); }).detach();
+			}
+
+			bool WritePPM(const std::string& filename, int width, int height, const std::vector<uint8_t>& rgb)
+			{
+				std::ofstream file(filename, std::ios::binary);
+				if (!file)
+					return false;
+
+				file << "P6\n" << width << " " << height << "\n255\n";
+				file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+				return static_cast<bool>(file);
+			}
+		}
+
+		int RunCoordinator(const CoordinatorSettings& settings)
+		{
+			TcpSocket listener{};
+			if (!listener.Listen(settings.port))
+			{
+				std::cout << "Could not listen on port " << settings.port << std::endl;
+				return 1;
+			}
+
+			std::cout << "**DISTRIBUTED RENDER** " << settings.sceneName << " " << settings.width << "x" << settings.height
+				<< ", waiting for " << settings.workerCount << " workers on port " << settings.port << std::endl;
+
+			for (int i{ 0 }; i < settings.localWorkerCount; ++i)
+				LaunchLocalWorker(settings.executable, settings.port);
+
+			//TcpSocket can't move, so they live on the heap
+			std::vector<std::unique_ptr<TcpSocket>> workers{};
+			while (static_cast<int>(workers.size()) < settings.workerCount)
+			{
+				auto pWorker = std::make_unique<TcpSocket>();
+				if (!listener.Accept(*pWorker))
+				{
+					std::cout << "Accepting a worker failed" << std::endl;
+					return 1;
+				}
+
+				pWorker->SetReceiveTimeout(settings.workerTimeout);
+				workers.push_back(std::move(pWorker));
+				std::cout << ">> worker " << workers.size() << " connected" << std::endl;
+			}
+
+			JobMessage job{};
+			job.width = settings.width;
+			job.height = settings.height;
+			job.time = settings.time;
+			job.shadowsEnabled = settings.shadowsEnabled ? 1 : 0;
+			job.lightingMode = static_cast<uint32_t>(settings.lightingMode);
+			job.primaryVisibility = static_cast<uint32_t>(settings.primaryVisibility);
+			job.lightSampling = static_cast<uint32_t>(settings.lightSampling);
+			job.lightSamplesPerHit = settings.lightSamplesPerHit;
+			job.lightCutoff = settings.lightCutoff;
+			job.lightmap = settings.lightmap ? 1 : 0;
+			std::strncpy(job.sceneName, settings.sceneName.c_str(), sizeof(job.sceneName) - 1);
+
+			const int tileCount{ Renderer::GetTileCount(settings.width, settings.height) };
+			TileScheduler scheduler{ tileCount, settings.stragglerTimeout };
+			std::vector<uint8_t> image(static_cast<size_t>(settings.width) * settings.height * 3);
+			std::vector<int> renderedTileCounts(workers.size());
+
+			const auto start = std::chrono::steady_clock::now();
+			{
+				PROFILE_ZONE("Distributed::RunCoordinator");
+
+				std::vector<std::atomic<bool>> isFinished(workers.size());
+				std::vector<std::thread> threads{};
+				for (size_t i{ 0 }; i < workers.size(); ++i)
+				{
+					scheduler.AddWorker();
+					threads.emplace_back([&, i]
+						{
+							DriveWorker(*workers[i], job, scheduler, image, renderedTileCounts[i]);
+							isFinished[i] = true;
+							scheduler.RemoveWorker();
+						});
+				}
+
+				//Workers still busy at this point are stuck on tiles somebody else already delivered
+				scheduler.WaitUntilDone();
+				for (size_t i{ 0 }; i < workers.size(); ++i)
+				{
+					if (!isFinished[i])
+						workers[i]->Shutdown();
+				}
+
+				for (std::thread& thread : threads)
+					thread.join();
+			}
+			const auto end = std::chrono::steady_clock::now();
+
+			for (const auto& pWorker : workers)
+				SendPacket(*pWorker, MessageType::Quit);
+
+			const int missingCount{ scheduler.GetRemainingCount() };
+			if (missingCount > 0)
+			{
+				std::cout << "Every worker is gone, " << missingCount << " of " << tileCount << " tiles missing" << std::endl;
+				return 1;
+			}
+
+			for (size_t i{ 0 }; i < workers.size(); ++i)
+				std::cout << ">> worker " << i + 1 << " rendered " << renderedTileCounts[i] << " tiles" << std::endl;
+			std::cout << ">> " << tileCount << " tiles, " << scheduler.GetReissuedCount() << " reissued, "
+				<< std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+
+			if (!WritePPM(settings.outputFile, settings.width, settings.height, image))
+			{
+				std::cout << "Could not write " << settings.outputFile << std::endl;
+				return 1;
+			}
+
+			std::cout << "**DISTRIBUTED RENDER FINISHED** written to " << settings.outputFile << std::endl;
+			return 0;
+		}
+
+		int RunWorker(const std::string& host, uint16_t port)
+		{
+			TcpSocket socket{};
+
+			//The coordinator might still be starting up
+			for (int attempt{ 0 }; attempt < 50 && !socket.Connect(host, port); ++attempt)
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+			if (!socket.IsValid())
+			{
+				std::cout << "Could not connect to " << host << ":" << port << std::endl;
+				return 1;
+			}
+
+			std::string sceneName{};
+			std::unique_ptr<Scene> pScene{};
+			std::unique_ptr<Renderer> pRenderer{};
+
+			while (true)
+			{
+				MessageHeader header{};
+				if (!ReceiveHeader(socket, header))
+					return 1;
+
+				switch (header.type)
+				{
+				case MessageType::Job:
+				{
+					JobMessage job{};
+					if (header.payloadSize != sizeof(job) || !socket.ReceiveAll(&job, sizeof(job)) || job.width <= 0 || job.height <= 0)
+						return 1;
+
+					job.sceneName[sizeof(job.sceneName) - 1] = '\0';
+
+					//Casting these unchecked would hand the renderer enum values it has no case for
+					if (job.lightingMode > static_cast<uint32_t>(Renderer::LightingMode::Combined)
+						|| job.primaryVisibility > static_cast<uint32_t>(Renderer::PrimaryVisibility::Rasterized)
+						|| job.lightSampling > static_cast<uint32_t>(Renderer::LightSampling::Importance)
+						|| job.lightSamplesPerHit < 1 || !std::isfinite(job.lightCutoff) || job.lightCutoff < 0.f)
+					{
+						std::cout << "Rejected a job with invalid render settings" << std::endl;
+						return 1;
+					}
+
+					//Loaded once, later jobs on the same scene only update it
+					if (sceneName != job.sceneName)
+					{
+						pScene.reset();
+						for (const SceneFactory& factory : GetSceneFactories())
+						{
+							if (std::strcmp(factory.name, job.sceneName) == 0)
+								pScene = factory.create();
+						}
+
+						if (!pScene)
+						{
+							std::cout << "Unknown scene " << job.sceneName << std::endl;
+							return 1;
+						}
+						pScene->Initialize();
+						sceneName = job.sceneName;
+					}
+
+					if (!pRenderer || pRenderer->GetWidth() != job.width || pRenderer->GetHeight() != job.height)
+					{
+						pRenderer = std::make_unique<Renderer>(job.width, job.height);
+						if (!pRenderer->IsValid())
+							return 1;
+					}
+
+					pRenderer->SetShadowsEnabled(job.shadowsEnabled != 0);
+					pRenderer->SetLightingMode(static_cast<Renderer::LightingMode>(job.lightingMode));
+					pRenderer->SetPrimaryVisibility(static_cast<Renderer::PrimaryVisibility>(job.primaryVisibility));
+					pRenderer->SetLightSampling(static_cast<Renderer::LightSampling>(job.lightSampling));
+					pRenderer->SetLightSamplesPerHit(job.lightSamplesPerHit);
+					pRenderer->SetLightCutoff(job.lightCutoff);
+
+					//Never started, the scene only sees the job's time
+					Timer timer{};
+					timer.SetSimulatedTime(job.time, 0.f);
+					pScene->Update(&timer);
+
+					//Baked per job, so every worker shades with the same lightmap whatever jobs it ran before
+					if (job.lightmap != 0)
+						pRenderer->BakeLightmap(pScene.get());
+					else
+						pRenderer->ClearLightmap();
+
+					//Every tile of the job shares it
+					pRenderer->BeginFrame(pScene.get());
+					break;
+				}
+				case MessageType::Tile:
+				{
+					TileMessage tile{};
+					if (header.payloadSize != sizeof(tile) || !socket.ReceiveAll(&tile, sizeof(tile)) || !pRenderer
+						|| tile.tileIndex < 0 || tile.tileIndex >= Renderer::GetTileCount(pRenderer->GetWidth(), pRenderer->GetHeight()))
+						return 1;
+
+					pRenderer->RenderTile(pScene.get(), tile.tileIndex);
+
+					const Renderer::Region region{ Renderer::GetTileRegion(tile.tileIndex, pRenderer->GetWidth(), pRenderer->GetHeight()) };
+					const TileResultMessage result{ tile.tileIndex, region.x, region.y, region.width, region.height };
+					const std::vector<uint8_t> pixels{ pRenderer->GetRegionRGB(region) };
+
+					if (!SendPacket(socket, MessageType::TileResult, &result, sizeof(result), pixels.data(), pixels.size()))
+						return 1;
+					break;
+				}
+				case MessageType::Quit:
+					return 0;
+				default:
+					return 1;
+				}
+			}
+		}
+	}
+}
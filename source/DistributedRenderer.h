@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "Renderer.h"
+
+namespace dae
+{
+	/**
+	 * One frame split into Renderer tiles and rendered by worker processes over TCP.
+	 * Every worker loads the scene once per job and renders the tiles it gets handed, one at a time.
+	 * Tiles that are out for longer than the straggler timeout get handed to idle workers as well, first result wins.
+	 * Workers that disconnect give their tile back. Messages are raw little endian structs.
+	 */
+	namespace Distributed
+	{
+		struct CoordinatorSettings
+		{
+			uint16_t port{ 5555 };
+
+			//Coordinator waits for this many workers before it starts handing out tiles
+			int workerCount{ 2 };
+			//How many of those it launches itself on localhost, the rest connect with --worker <host> <port>
+			int localWorkerCount{ 0 };
+			//Used to launch the local workers
+			std::string executable{};
+
+			std::string sceneName{ "Scene_W4_ReferenceScene" };
+			int width{ 640 };
+			int height{ 480 };
+			float time{ 0.f };
+			bool shadowsEnabled{ true };
+			Renderer::LightingMode lightingMode{ Renderer::LightingMode::Combined };
+			Renderer::PrimaryVisibility primaryVisibility{ Renderer::PrimaryVisibility::RayTraced };
+			Renderer::LightSampling lightSampling{ Renderer::LightSampling::AllLights };
+			int lightSamplesPerHit{ 4 };
+			float lightCutoff{ 0.f };
+			//Every worker bakes the static planes of the scene at the job's time
+			bool lightmap{ false };
+
+			std::string outputFile{ "distributed.ppm" };
+
+			float stragglerTimeout{ 2.f };
+			//A worker that stays quiet this long is considered gone
+			float workerTimeout{ 30.f };
+		};
+
+		/**
+		 * \brief Waits for the workers, renders one frame with them and writes it as a binary PPM
+		 * \return 0 on success
+		 */
+		int RunCoordinator(const CoordinatorSettings& settings);
+
+		/**
+		 * \brief Connects to a coordinator and renders tiles until it sends quit or the connection drops
+		 * \return 0 when the coordinator ended the session
+		 */
+		int RunWorker(const std::string& host, uint16_t port);
+	}
+}
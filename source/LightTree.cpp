@@ -0,0 +1,139 @@
+#include "LightTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "Profiler.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Lights a little behind the surface point still count, rounding can put a grazing light on either side
+		constexpr float BehindTolerance{ 1e-4f };
+		//Keeps a light sitting on the surface from taking every pick with an infinite importance
+		constexpr float MinDistanceSquared{ 1e-4f };
+		//Lowest cosine a light in front of the surface is weighted with
+		constexpr float MinCosine{ 0.01f };
+		//Largest float below 1, u has to stay inside [0, 1) after every rescale
+		constexpr float OneMinusEpsilon{ 0x1.fffffep-1f };
+	}
+
+	void LightTree::Build(const std::vector<Light>& lights)
+	{
+		PROFILE_ZONE("LightTree::Build");
+
+		m_Nodes.clear();
+		m_LightOrder.resize(lights.size());
+		std::iota(m_LightOrder.begin(), m_LightOrder.end(), 0u);
+
+		if (lights.empty())
+			return;
+
+		//A binary tree with one light per leaf has 2n - 1 nodes
+		m_Nodes.reserve(2 * lights.size() - 1);
+		m_Nodes.emplace_back();
+		BuildNode(lights, 0, 0, lights.size());
+	}
+
+	void LightTree::BuildNode(const std::vector<Light>& lights, unsigned int nodeIndex, size_t first, size_t last)
+	{
+		Node node{};
+		node.min = lights[m_LightOrder[first]].origin;
+		node.max = node.min;
+		for (size_t i{ first }; i < last; ++i)
+		{
+			const Light& light{ lights[m_LightOrder[i]] };
+			node.min = Vector3::Min(light.origin, node.min);
+			node.max = Vector3::Max(light.origin, node.max);
+			node.power += light.intensity * (light.color.r + light.color.g + light.color.b);
+		}
+
+		if (last - first == 1)
+		{
+			node.isLeaf = true;
+			node.lightIndex = m_LightOrder[first];
+			m_Nodes[nodeIndex] = node;
+			return;
+		}
+
+		//Median split along the widest axis, keeps the tree balanced however the lights are spread
+		const Vector3 extent{ node.max - node.min };
+		const int axis{ extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2 };
+		const size_t middle{ first + (last - first) / 2 };
+		std::nth_element(m_LightOrder.begin() + first, m_LightOrder.begin() + middle, m_LightOrder.begin() + last,
+			[&lights, axis](unsigned int a, unsigned int b) { return lights[a].origin[axis] < lights[b].origin[axis]; });
+
+		node.firstChild = static_cast<unsigned int>(m_Nodes.size());
+		m_Nodes.resize(m_Nodes.size() + 2);
+		m_Nodes[nodeIndex] = node;
+
+		BuildNode(lights, node.firstChild, first, middle);
+		BuildNode(lights, node.firstChild + 1, middle, last);
+	}
+
+	bool LightTree::PickLight(const Vector3& origin, const Vector3& normal, float u, LightPick& pick) const
+	{
+		if (m_Nodes.empty() || GetImportance(m_Nodes[0], origin, normal) <= 0.f)
+			return false;
+
+		float probability{ 1.f };
+		const Node* pNode{ &m_Nodes[0] };
+		while (!pNode->isLeaf)
+		{
+			const Node& left{ m_Nodes[pNode->firstChild] };
+			const Node& right{ m_Nodes[pNode->firstChild + 1] };
+			const float leftImportance{ GetImportance(left, origin, normal) };
+			const float totalImportance{ leftImportance + GetImportance(right, origin, normal) };
+
+			//The parent's box can reach in front of the surface while both children's lie behind it
+			if (totalImportance <= 0.f)
+				return false;
+
+			//u picks a child and is then stretched back to [0, 1), so one number serves the whole path
+			const float leftProbability{ leftImportance / totalImportance };
+			if (u < leftProbability)
+			{
+				u = std::min(u / leftProbability, OneMinusEpsilon);
+				probability *= leftProbability;
+				pNode = &left;
+			}
+			else
+			{
+				u = std::min((u - leftProbability) / (1.f - leftProbability), OneMinusEpsilon);
+				probability *= 1.f - leftProbability;
+				pNode = &right;
+			}
+		}
+
+		pick.lightIndex = pNode->lightIndex;
+		pick.probability = probability;
+		return true;
+	}
+
+	float LightTree::GetImportance(const Node& node, const Vector3& origin, const Vector3& normal) const
+	{
+		//Farthest any point of the box gets in front of the surface, the corner the normal points to
+		const Vector3 farCorner{
+			normal.x >= 0.f ? node.max.x : node.min.x,
+			normal.y >= 0.f ? node.max.y : node.min.y,
+			normal.z >= 0.f ? node.max.z : node.min.z };
+		if (Vector3::Dot(farCorner - origin, normal) < -BehindTolerance)
+			return 0.f;
+
+		//A single light is a point, its cosine is known exactly. Never zero though, a grazing light still has to get picked
+		if (node.isLeaf)
+		{
+			const Vector3 toLight{ node.min - origin };
+			const float distanceSquared{ std::max(toLight.SqrMagnitude(), MinDistanceSquared) };
+			const float cosine{ Vector3::Dot(toLight, normal) / sqrtf(distanceSquared) };
+			return node.power * std::max(cosine, MinCosine) / distanceSquared;
+		}
+
+		//Inside or close to a cluster the distance to its center says little, never count it closer than the half diagonal
+		const Vector3 center{ (node.min + node.max) * 0.5f };
+		const float distanceSquared{ std::max((center - origin).SqrMagnitude(), (node.max - node.min).SqrMagnitude() * 0.25f) };
+		return node.power / std::max(distanceSquared, MinDistanceSquared);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+
+#include "DataTypes.h"
+#include "Math.h"
+
+namespace dae
+{
+	/**
+	 * Binary hierarchy over the scene's lights, so a hit can be shaded with a few lights picked by how much they're expected
+	 * to contribute instead of with every one of them. A pick walks down from the root and chooses between the two children
+	 * with probability proportional to their importance: summed power over squared distance, zero when all of a child's lights
+	 * are behind the surface. The probability of the whole path is returned, dividing the light's contribution by it keeps the estimate unbiased.
+	 */
+	class LightTree final
+	{
+	public:
+		struct LightPick
+		{
+			unsigned int lightIndex{};
+			float probability{};
+		};
+
+		LightTree() = default;
+		~LightTree() = default;
+
+		LightTree(const LightTree&) = delete;
+		LightTree(LightTree&&) noexcept = delete;
+		LightTree& operator=(const LightTree&) = delete;
+		LightTree& operator=(LightTree&&) noexcept = delete;
+
+		//Lights are treated as points at their origin, like LightUtils does
+		void Build(const std::vector<Light>& lights);
+		//Picks one light for a surface point with u uniform in [0, 1), false when no light can reach the point
+		bool PickLight(const Vector3& origin, const Vector3& normal, float u, LightPick& pick) const;
+
+	private:
+		struct Node
+		{
+			Vector3 min{};
+			Vector3 max{};
+			//Intensity times summed color channels of every light below
+			float power{};
+
+			//Inner nodes have their children at firstChild and firstChild + 1
+			unsigned int firstChild{};
+			unsigned int lightIndex{};
+			bool isLeaf{ false };
+		};
+
+		std::vector<Node> m_Nodes{};
+		//Light indices, reordered while building
+		std::vector<unsigned int> m_LightOrder{};
+
+		void BuildNode(const std::vector<Light>& lights, unsigned int nodeIndex, size_t first, size_t last);
+		float GetImportance(const Node& node, const Vector3& origin, const Vector3& normal) const;
+	};
+}
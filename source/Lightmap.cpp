@@ -0,0 +1,168 @@
+#include "Lightmap.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Profiler.h"
+#include "Scene.h"
+
+namespace dae
+{
+	void Lightmap::Layout(const std::vector<Plane>& planes, const std::vector<uint8_t>& isBaked, const Bounds& bounds, float texelSize, size_t nrLights)
+	{
+		PROFILE_ZONE("Lightmap::Layout");
+
+		m_NrLights = nrLights;
+		m_Charts.clear();
+		m_PlaneCharts.assign(planes.size(), -1);
+
+		//Rectangle on each plane covering the bounds, in world units along the chart's axes
+		struct Rect
+		{
+			float minU{ FLT_MAX }, minV{ FLT_MAX };
+			float maxU{ -FLT_MAX }, maxV{ -FLT_MAX };
+		};
+		std::vector<Rect> rects{};
+
+		for (unsigned int i{ 0 }; i < static_cast<unsigned int>(planes.size()); ++i)
+		{
+			if (!isBaked[i])
+				continue;
+
+			Chart chart{};
+			chart.planeIndex = i;
+
+			//Any two axes in the plane do, start from whichever world axis is furthest from the normal
+			const Vector3& normal{ planes[i].normal };
+			const Vector3 reference{ std::abs(normal.y) < 0.9f ? Vector3::UnitY : Vector3::UnitX };
+			chart.axisU = Vector3::Cross(reference, normal).Normalized();
+			chart.axisV = Vector3::Cross(normal, chart.axisU);
+
+			Rect rect{};
+			for (int corner{ 0 }; corner < 8; ++corner)
+			{
+				const Vector3 point{
+					(corner & 1) ? bounds.max.x : bounds.min.x,
+					(corner & 2) ? bounds.max.y : bounds.min.y,
+					(corner & 4) ? bounds.max.z : bounds.min.z };
+
+				const Vector3 local{ point - planes[i].origin };
+				rect.minU = std::min(rect.minU, Vector3::Dot(local, chart.axisU));
+				rect.maxU = std::max(rect.maxU, Vector3::Dot(local, chart.axisU));
+				rect.minV = std::min(rect.minV, Vector3::Dot(local, chart.axisV));
+				rect.maxV = std::max(rect.maxV, Vector3::Dot(local, chart.axisV));
+			}
+
+			chart.origin = planes[i].origin + chart.axisU * rect.minU + chart.axisV * rect.minV;
+			m_PlaneCharts[i] = static_cast<int>(m_Charts.size());
+			m_Charts.push_back(chart);
+			rects.push_back(rect);
+		}
+
+		//Texel centers span the whole rectangle, at least 2 x 2 so every point has 4 texels around it
+		const auto layoutTexels = [&](float size)
+			{
+				size_t nrTexels{ 0 };
+				for (size_t i{ 0 }; i < m_Charts.size(); ++i)
+				{
+					Chart& chart{ m_Charts[i] };
+					chart.texelSize = size;
+					chart.width = std::max(static_cast<int>(std::ceil((rects[i].maxU - rects[i].minU) / size)) + 1, 2);
+					chart.height = std::max(static_cast<int>(std::ceil((rects[i].maxV - rects[i].minV) / size)) + 1, 2);
+					chart.firstTexel = nrTexels;
+					nrTexels += static_cast<size_t>(chart.width) * chart.height;
+				}
+				return nrTexels;
+			};
+
+		//Without lights the texels still get laid out and walked by the bake, so they count as one light
+		const size_t valuesPerTexel{ std::max(nrLights, size_t{ 1 }) };
+		size_t nrTexels{ layoutTexels(texelSize) };
+		while (nrTexels * valuesPerTexel > MaxValues)
+		{
+			//Texel count goes with 1 / size^2, the + 1 per row needs the occasional extra step
+			texelSize *= std::max(std::sqrt(static_cast<float>(nrTexels * valuesPerTexel) / MaxValues), 1.01f);
+			nrTexels = layoutTexels(texelSize);
+		}
+
+		m_Light.assign(nrTexels * nrLights, ColorRGB{});
+
+		//A little slack, texels exactly on the corner line are fine on both planes
+		constexpr float BehindTolerance{ 1e-4f };
+		m_IsTexelValid.assign(nrTexels, 1);
+		for (const Chart& chart : m_Charts)
+		{
+			for (int y{ 0 }; y < chart.height; ++y)
+			{
+				for (int x{ 0 }; x < chart.width; ++x)
+				{
+					const Vector3 position{ GetTexelPosition(chart, x, y) };
+					for (unsigned int i{ 0 }; i < static_cast<unsigned int>(planes.size()); ++i)
+					{
+						if (i != chart.planeIndex && Vector3::Dot(position - planes[i].origin, planes[i].normal) < -BehindTolerance)
+						{
+							m_IsTexelValid[chart.firstTexel + static_cast<size_t>(y) * chart.width + x] = 0;
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	Vector3 Lightmap::GetTexelPosition(const Chart& chart, int x, int y) const
+	{
+		return chart.origin + chart.axisU * (x * chart.texelSize) + chart.axisV * (y * chart.texelSize);
+	}
+
+	bool Lightmap::Lookup(unsigned int planeIndex, const Vector3& point, TexelLookup& lookup) const
+	{
+		if (planeIndex >= m_PlaneCharts.size() || m_PlaneCharts[planeIndex] < 0)
+			return false;
+
+		const Chart& chart{ m_Charts[m_PlaneCharts[planeIndex]] };
+		const Vector3 local{ point - chart.origin };
+		const float x{ Vector3::Dot(local, chart.axisU) / chart.texelSize };
+		const float y{ Vector3::Dot(local, chart.axisV) / chart.texelSize };
+		if (!(x >= 0.f && y >= 0.f && x <= chart.width - 1 && y <= chart.height - 1))
+			return false;
+
+		const int x0{ std::min(static_cast<int>(x), chart.width - 2) };
+		const int y0{ std::min(static_cast<int>(y), chart.height - 2) };
+		const float fx{ x - x0 };
+		const float fy{ y - y0 };
+
+		const size_t texel{ chart.firstTexel + static_cast<size_t>(y0) * chart.width + x0 };
+		lookup.texels[0] = texel;
+		lookup.texels[1] = texel + 1;
+		lookup.texels[2] = texel + chart.width;
+		lookup.texels[3] = texel + chart.width + 1;
+		lookup.weights[0] = (1.f - fx) * (1.f - fy);
+		lookup.weights[1] = fx * (1.f - fy);
+		lookup.weights[2] = (1.f - fx) * fy;
+		lookup.weights[3] = fx * fy;
+
+		float totalWeight{ 0.f };
+		for (int i{ 0 }; i < 4; ++i)
+		{
+			if (!m_IsTexelValid[lookup.texels[i]])
+				lookup.weights[i] = 0.f;
+			totalWeight += lookup.weights[i];
+		}
+
+		if (totalWeight <= 0.f)
+			return false;
+
+		for (float& weight : lookup.weights)
+			weight /= totalWeight;
+		return true;
+	}
+
+	ColorRGB Lightmap::GetLight(const TexelLookup& lookup, unsigned int lightIndex) const
+	{
+		ColorRGB light{};
+		for (int i{ 0 }; i < 4; ++i)
+			light += m_Light[lookup.texels[i] * m_NrLights + lightIndex] * lookup.weights[i];
+		return light;
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "ColorRGB.h"
+#include "DataTypes.h"
+#include "Math.h"
+
+namespace dae
+{
+	struct Bounds;
+
+	/**
+	 * Direct light of every light, baked into texels on the static planes, so hits on them don't need shading or static shadow rays.
+	 * Each baked plane gets one chart: the rectangle of it inside the bake bounds, texel centers texelSize apart.
+	 * Texels hold the light per light so shadows of moving objects can still remove a single light at render time.
+	 */
+	class Lightmap final
+	{
+	public:
+		struct Chart
+		{
+			unsigned int planeIndex{};
+
+			//Texel (x, y) is centered on origin + axisU * x * texelSize + axisV * y * texelSize
+			Vector3 origin{};
+			Vector3 axisU{};
+			Vector3 axisV{};
+			float texelSize{};
+			int width{};
+			int height{};
+
+			size_t firstTexel{};
+		};
+
+		//The 4 texels around a point and their bilinear weights
+		struct TexelLookup
+		{
+			size_t texels[4]{};
+			float weights[4]{};
+		};
+
+		//Caps texels * lights, about 48 MB of light. Bigger bakes get coarser texels
+		static constexpr size_t MaxValues{ size_t{ 1 } << 22 };
+
+		Lightmap() = default;
+		~Lightmap() = default;
+
+		Lightmap(const Lightmap&) = delete;
+		Lightmap(Lightmap&&) noexcept = delete;
+		Lightmap& operator=(const Lightmap&) = delete;
+		Lightmap& operator=(Lightmap&&) noexcept = delete;
+
+		//Charts for every plane with isBaked set, all texels black. Texels behind any other plane are left out,
+		//they're baked in that plane's shadow and would darken the corner where the two meet
+		void Layout(const std::vector<Plane>& planes, const std::vector<uint8_t>& isBaked, const Bounds& bounds, float texelSize, size_t nrLights);
+
+		const std::vector<Chart>& GetCharts() const { return m_Charts; }
+		size_t GetLightCount() const { return m_NrLights; }
+		Vector3 GetTexelPosition(const Chart& chart, int x, int y) const;
+		void SetLight(size_t texel, size_t lightIndex, const ColorRGB& light) { m_Light[texel * m_NrLights + lightIndex] = light; }
+		bool IsTexelValid(size_t texel) const { return m_IsTexelValid[texel] != 0; }
+
+		//Only the valid texels around the point, weights renormalized.
+		//False when the plane isn't baked, the point lies outside its chart or none of its texels are valid
+		bool Lookup(unsigned int planeIndex, const Vector3& point, TexelLookup& lookup) const;
+		ColorRGB GetLight(const TexelLookup& lookup, unsigned int lightIndex) const;
+
+	private:
+		std::vector<Chart> m_Charts{};
+		//Chart per plane, -1 when it isn't baked
+		std::vector<int> m_PlaneCharts{};
+
+		std::vector<uint8_t> m_IsTexelValid{};
+
+		size_t m_NrLights{};
+		//Light of texel t from light l is at t * m_NrLights + l
+		std::vector<ColorRGB> m_Light{};
+	};
+}
@@ -0,0 +1,77 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace dae;
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& filename)
+{
+	const HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	m_FileHandle = file;
+
+	LARGE_INTEGER fileSize{};
+	//Empty files can't be mapped
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		return;
+
+	m_MappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_MappingHandle)
+		return;
+
+	m_pData = static_cast<const char*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (m_pData)
+		m_Size = static_cast<size_t>(fileSize.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_MappingHandle)
+		CloseHandle(m_MappingHandle);
+	if (m_FileHandle)
+		CloseHandle(m_FileHandle);
+}
+#else
+MappedFile::MappedFile(const std::string& filename)
+{
+	m_FileDescriptor = open(filename.c_str(), O_RDONLY);
+	if (m_FileDescriptor < 0)
+		return;
+
+	struct stat fileStats{};
+	//Empty files can't be mapped
+	if (fstat(m_FileDescriptor, &fileStats) != 0 || fileStats.st_size == 0)
+		return;
+
+	void* pData = mmap(nullptr, static_cast<size_t>(fileStats.st_size), PROT_READ, MAP_PRIVATE, m_FileDescriptor, 0);
+	if (pData == MAP_FAILED)
+		return;
+
+	madvise(pData, static_cast<size_t>(fileStats.st_size), MADV_SEQUENTIAL);
+	m_pData = static_cast<const char*>(pData);
+	m_Size = static_cast<size_t>(fileStats.st_size);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_pData)
+		munmap(const_cast<char*>(m_pData), m_Size);
+	if (m_FileDescriptor >= 0)
+		close(m_FileDescriptor);
+}
+#endif
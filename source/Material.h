@@ -25,6 +25,8 @@ namespace dae
 		 * \return color
 		 */
 		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+		//Shade ignores the view direction, light on such a surface can be baked
+		virtual bool IsViewIndependent() const { return false; }
 	};
 #pragma endregion
 
@@ -43,6 +45,8 @@ namespace dae
 			return m_Color;
 		}
 
+		bool IsViewIndependent() const override { return true; }
+
 	private:
 		ColorRGB m_Color{colors::White};
 	};
@@ -62,6 +66,8 @@ namespace dae
 			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
 		}
 
+		bool IsViewIndependent() const override { return true; }
+
 	private:
 		ColorRGB m_DiffuseColor{colors::White};
 		float m_DiffuseReflectance{1.f}; //kd
@@ -82,6 +82,42 @@ namespace dae {
 		return out;
 	}
 
+	//Only valid for affine matrices (last column 0,0,0,1), which is all this project builds
+	const Matrix& Matrix::Inverse()
+	{
+		const Vector3 x{ data[0] };
+		const Vector3 y{ data[1] };
+		const Vector3 z{ data[2] };
+		const Vector3 t{ data[3] };
+
+		//Rows of the inverse 3x3 are the cross products of the columns divided by the determinant
+		const Vector3 yz{ Vector3::Cross(y, z) };
+		const Vector3 zx{ Vector3::Cross(z, x) };
+		const Vector3 xy{ Vector3::Cross(x, y) };
+		const float determinant{ Vector3::Dot(x, yz) };
+		assert(!AreEqual(determinant, 0.f, 1e-12f));
+		const float invDeterminant{ 1.f / determinant };
+
+		const Matrix transposedInverse{ yz * invDeterminant, zx * invDeterminant, xy * invDeterminant, Vector3::Zero };
+		Matrix result{ Transpose(transposedInverse) };
+		result[3] = { -result.TransformVector(t), 1.f };
+
+		data[0] = result[0];
+		data[1] = result[1];
+		data[2] = result[2];
+		data[3] = result[3];
+
+		return *this;
+	}
+
+	Matrix Matrix::Inverse(const Matrix& m)
+	{
+		Matrix out{ m };
+		out.Inverse();
+
+		return out;
+	}
+
 	Vector3 Matrix::GetAxisX() const
 	{
 		return data[0];
@@ -0,0 +1,212 @@
+#include "MeshCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "MappedFile.h"
+
+namespace dae
+{
+	namespace MeshCache
+	{
+		//Sections are raw copies of the mesh vectors
+		static_assert(sizeof(Vector3) == 3 * sizeof(float), "Vector3 has to be tightly packed for the cache layout");
+
+		namespace
+		{
+			constexpr uint64_t SectionAlignment{ 16 };
+
+			uint64_t AlignOffset(uint64_t offset)
+			{
+				return (offset + SectionAlignment - 1) & ~(SectionAlignment - 1);
+			}
+
+			//FNV-1a, only used to detect a changed source file
+			uint64_t HashBytes(const char* pData, size_t size)
+			{
+				uint64_t hash{ 14695981039346656037ull };
+				for (size_t i = 0; i < size; ++i)
+				{
+					hash ^= static_cast<unsigned char>(pData[i]);
+					hash *= 1099511628211ull;
+				}
+				return hash;
+			}
+
+			bool GetSourceInfo(const std::string& objFilename, int64_t& timestamp, uint64_t& size)
+			{
+				std::error_code error{};
+				const auto writeTime = std::filesystem::last_write_time(objFilename, error);
+				if (error)
+					return false;
+
+				size = std::filesystem::file_size(objFilename, error);
+				if (error)
+					return false;
+
+				timestamp = static_cast<int64_t>(writeTime.time_since_epoch().count());
+				return true;
+			}
+
+			bool GetSourceHash(const std::string& objFilename, uint64_t& hash)
+			{
+				const MappedFile source{ objFilename };
+				if (!source.IsValid())
+					return false;
+
+				hash = HashBytes(source.GetData(), source.GetSize());
+				return true;
+			}
+
+			template<typename T>
+			bool IsSectionInside(uint64_t offset, uint32_t count, size_t fileSize)
+			{
+				return offset % SectionAlignment == 0 && offset <= fileSize && count <= (fileSize - offset) / sizeof(T);
+			}
+
+			//Also hands back the header and the source's current timestamp, the mapping is closed once this returns
+			bool ReadCache(const std::string& objFilename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices,
+				Header& header, int64_t& timestamp)
+			{
+				const MappedFile cache{ GetCacheFilename(objFilename) };
+				if (!cache.IsValid() || cache.GetSize() < sizeof(Header))
+					return false;
+
+				std::memcpy(&header, cache.GetData(), sizeof(Header));
+				if (std::memcmp(header.magic, Header{}.magic, sizeof(header.magic)) != 0 || header.version != Version)
+					return false;
+
+				const size_t fileSize = cache.GetSize();
+				if (!IsSectionInside<Vector3>(header.positionsOffset, header.positionCount, fileSize)
+					|| !IsSectionInside<int>(header.indicesOffset, header.indexCount, fileSize)
+					|| !IsSectionInside<Vector3>(header.normalsOffset, header.normalCount, fileSize))
+					return false;
+
+				//One normal per triangle
+				if (header.indexCount % 3 != 0 || header.normalCount != header.indexCount / 3)
+					return false;
+
+				//Unchanged size + timestamp is trusted, otherwise fall back on the content hash (e.g. after a fresh checkout)
+				uint64_t size{};
+				if (!GetSourceInfo(objFilename, timestamp, size) || size != header.sourceSize)
+					return false;
+
+				if (timestamp != header.sourceTimestamp)
+				{
+					uint64_t hash{};
+					if (!GetSourceHash(objFilename, hash) || hash != header.sourceHash)
+						return false;
+				}
+
+				//Sections are laid out exactly like the vectors, so this is a straight copy out of the mapping
+				const char* pData = cache.GetData();
+				const Vector3* pPositions = reinterpret_cast<const Vector3*>(pData + header.positionsOffset);
+				const int* pIndices = reinterpret_cast<const int*>(pData + header.indicesOffset);
+				const Vector3* pNormals = reinterpret_cast<const Vector3*>(pData + header.normalsOffset);
+
+				//Traversal trusts the indices, a cache that points outside its positions is treated as a miss
+				for (uint32_t i{ 0 }; i < header.indexCount; ++i)
+				{
+					if (pIndices[i] < 0 || static_cast<uint32_t>(pIndices[i]) >= header.positionCount)
+						return false;
+				}
+
+				positions.assign(pPositions, pPositions + header.positionCount);
+				indices.assign(pIndices, pIndices + header.indexCount);
+				normals.assign(pNormals, pNormals + header.normalCount);
+
+				return true;
+			}
+
+			//Writes next to the final file and swaps it in, a half written cache is never picked up
+			bool WriteCache(const std::string& cacheFilename, Header header,
+				const std::vector<Vector3>& positions, const std::vector<Vector3>& normals, const std::vector<int>& indices)
+			{
+				header.positionCount = static_cast<uint32_t>(positions.size());
+				header.indexCount = static_cast<uint32_t>(indices.size());
+				header.normalCount = static_cast<uint32_t>(normals.size());
+
+				header.positionsOffset = AlignOffset(sizeof(Header));
+				header.indicesOffset = AlignOffset(header.positionsOffset + positions.size() * sizeof(Vector3));
+				header.normalsOffset = AlignOffset(header.indicesOffset + indices.size() * sizeof(int));
+				header.bvhOffset = AlignOffset(header.normalsOffset + normals.size() * sizeof(Vector3));
+
+				const std::string tempFilename = cacheFilename + ".tmp";
+				std::error_code error{};
+				bool isWritten{ false };
+				{
+					std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+					if (file)
+					{
+						const char padding[SectionAlignment]{};
+						const auto writeSection = [&](uint64_t offset, const void* pData, size_t size)
+							{
+								file.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(file.tellp())));
+								file.write(static_cast<const char*>(pData), static_cast<std::streamsize>(size));
+							};
+
+						file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+						writeSection(header.positionsOffset, positions.data(), positions.size() * sizeof(Vector3));
+						writeSection(header.indicesOffset, indices.data(), indices.size() * sizeof(int));
+						writeSection(header.normalsOffset, normals.data(), normals.size() * sizeof(Vector3));
+
+						file.close();
+						isWritten = static_cast<bool>(file);
+					}
+				}
+
+				//Closed first, Windows can't remove a file that's still open
+				if (!isWritten)
+				{
+					std::filesystem::remove(tempFilename, error);
+					return false;
+				}
+
+				std::filesystem::rename(tempFilename, cacheFilename, error);
+				if (error)
+				{
+					std::filesystem::remove(tempFilename, error);
+					return false;
+				}
+
+				return true;
+			}
+		}
+
+		std::string GetCacheFilename(const std::string& objFilename)
+		{
+			return objFilename + ".rtmesh";
+		}
+
+		bool Read(const std::string& objFilename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
+		{
+			Header header{};
+			int64_t timestamp{};
+			if (!ReadCache(objFilename, positions, normals, indices, header, timestamp))
+				return false;
+
+			//Only the content hash matched, store the new timestamp so the next load skips hashing again.
+			//The mesh is loaded either way, a failed refresh just means hashing next time too
+			if (timestamp != header.sourceTimestamp)
+			{
+				header.sourceTimestamp = timestamp;
+				WriteCache(GetCacheFilename(objFilename), header, positions, normals, indices);
+			}
+
+			return true;
+		}
+
+		bool Write(const std::string& objFilename, const std::vector<Vector3>& positions, const std::vector<Vector3>& normals, const std::vector<int>& indices)
+		{
+			Header header{};
+			header.version = Version;
+
+			if (!GetSourceInfo(objFilename, header.sourceTimestamp, header.sourceSize)
+				|| !GetSourceHash(objFilename, header.sourceHash))
+				return false;
+
+			return WriteCache(GetCacheFilename(objFilename), header, positions, normals, indices);
+		}
+	}
+}
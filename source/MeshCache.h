@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	namespace MeshCache
+	{
+		//Binary layout: header followed by 16 byte aligned sections, offsets are from the start of the file
+		struct alignas(16) Header
+		{
+			char magic[4]{ 'R', 'T', 'M', 'C' };
+			uint32_t version{};
+
+			//Source OBJ the cache was built from
+			uint64_t sourceHash{};
+			int64_t sourceTimestamp{};
+			uint64_t sourceSize{};
+
+			uint32_t positionCount{};
+			uint32_t indexCount{};
+			uint32_t normalCount{};
+			uint32_t bvhNodeCount{}; //Reserved, no hierarchy is stored yet
+
+			uint64_t positionsOffset{};
+			uint64_t indicesOffset{};
+			uint64_t normalsOffset{};
+			uint64_t bvhOffset{};
+		};
+
+		constexpr uint32_t Version{ 1 };
+
+		std::string GetCacheFilename(const std::string& objFilename);
+
+		bool Read(const std::string& objFilename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices);
+		bool Write(const std::string& objFilename, const std::vector<Vector3>& positions, const std::vector<Vector3>& normals, const std::vector<int>& indices);
+	}
+}
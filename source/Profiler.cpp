@@ -0,0 +1,102 @@
+#include "Profiler.h"
+
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+namespace dae
+{
+	namespace Profiler
+	{
+		namespace
+		{
+			std::mutex g_RegistryMutex{};
+			std::deque<std::unique_ptr<ThreadBuffer>> g_ThreadBuffers{};
+
+			std::atomic<bool> g_IsCapturing{ false };
+			std::atomic<uint64_t> g_CaptureStartNs{ 0 };
+
+			uint64_t GetAbsoluteNs()
+			{
+				return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count());
+			}
+		}
+
+		ThreadBuffer* RegisterThread()
+		{
+			const std::lock_guard<std::mutex> lock{ g_RegistryMutex };
+
+			auto pBuffer = std::make_unique<ThreadBuffer>();
+			pBuffer->threadIndex = static_cast<uint32_t>(g_ThreadBuffers.size());
+			g_ThreadBuffers.push_back(std::move(pBuffer));
+			return g_ThreadBuffers.back().get();
+		}
+
+		bool IsCapturing()
+		{
+			return g_IsCapturing.load(std::memory_order_relaxed);
+		}
+
+		uint64_t GetTimestamp()
+		{
+			return GetAbsoluteNs() - g_CaptureStartNs.load(std::memory_order_relaxed);
+		}
+
+		void BeginCapture()
+		{
+			{
+				const std::lock_guard<std::mutex> lock{ g_RegistryMutex };
+				for (const auto& pBuffer : g_ThreadBuffers)
+					pBuffer->head.store(0, std::memory_order_relaxed);
+			}
+
+			g_CaptureStartNs.store(GetAbsoluteNs());
+			g_IsCapturing.store(true);
+		}
+
+		bool EndCapture(const std::string& filename)
+		{
+			g_IsCapturing.store(false);
+
+			std::ofstream file(filename);
+			if (!file)
+				return false;
+
+			file << std::fixed << std::setprecision(3);
+			file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+			const std::lock_guard<std::mutex> lock{ g_RegistryMutex };
+			bool isFirst{ true };
+			for (const auto& pBuffer : g_ThreadBuffers)
+			{
+				const uint64_t head{ pBuffer->head.load(std::memory_order_acquire) };
+				if (head == 0)
+					continue;
+
+				file << (isFirst ? "" : ",\n");
+				isFirst = false;
+				file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << pBuffer->threadIndex
+					<< ",\"args\":{\"name\":\"Thread " << pBuffer->threadIndex << "\"}}";
+
+				//Only the newest Capacity events survive a wrap
+				const uint64_t first{ head > ThreadBuffer::Capacity ? head - ThreadBuffer::Capacity : 0 };
+				for (uint64_t i{ first }; i < head; ++i)
+				{
+					const Event& event{ pBuffer->events[i & (ThreadBuffer::Capacity - 1)] };
+
+					//trace_event timestamps are in microseconds
+					file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << pBuffer->threadIndex
+						<< ",\"ts\":" << event.beginNs / 1000.0
+						<< ",\"dur\":" << (event.endNs - event.beginNs) / 1000.0 << "}";
+				}
+			}
+
+			file << "\n]}\n";
+			return static_cast<bool>(file);
+		}
+	}
+}
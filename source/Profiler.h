@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	namespace Profiler
+	{
+		struct Event
+		{
+			const char* name{};
+			uint64_t beginNs{};
+			uint64_t endNs{};
+		};
+
+		//Single producer ring per thread, the oldest events get overwritten once it's full
+		struct alignas(64) ThreadBuffer
+		{
+			static constexpr uint64_t Capacity{ 1 << 16 };
+
+			uint32_t threadIndex{};
+			std::atomic<uint64_t> head{ 0 };
+			Event events[Capacity]{};
+		};
+
+		ThreadBuffer* RegisterThread();
+		bool IsCapturing();
+		uint64_t GetTimestamp();
+
+		inline void Record(const char* name, uint64_t beginNs, uint64_t endNs)
+		{
+			static thread_local ThreadBuffer* pBuffer{ RegisterThread() };
+
+			const uint64_t index{ pBuffer->head.load(std::memory_order_relaxed) };
+			pBuffer->events[index & (ThreadBuffer::Capacity - 1)] = { name, beginNs, endNs };
+			pBuffer->head.store(index + 1, std::memory_order_release);
+		}
+
+		//Clears every thread's events, zones only record while a capture is running
+		void BeginCapture();
+		//Writes everything recorded since BeginCapture as Chrome trace_event JSON (chrome://tracing, Perfetto)
+		bool EndCapture(const std::string& filename);
+
+		//RAII zone, name has to outlive the capture (string literals)
+		class Zone final
+		{
+		public:
+			Zone(const char* name) :
+				m_Name(name),
+				m_IsRecording(IsCapturing()),
+				m_BeginNs(m_IsRecording ? GetTimestamp() : 0)
+			{
+			}
+
+			~Zone()
+			{
+				if (m_IsRecording)
+					Record(m_Name, m_BeginNs, GetTimestamp());
+			}
+
+			Zone(const Zone&) = delete;
+			Zone(Zone&&) noexcept = delete;
+			Zone& operator=(const Zone&) = delete;
+			Zone& operator=(Zone&&) noexcept = delete;
+
+		private:
+			const char* m_Name{};
+			//Read once, a capture starting or stopping mid zone must not record half of it. Declared before m_BeginNs, which depends on it
+			bool m_IsRecording{};
+			uint64_t m_BeginNs{};
+		};
+	}
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) const dae::Profiler::Zone PROFILE_CONCAT(profileZone_, __LINE__){ name }
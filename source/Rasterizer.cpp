@@ -0,0 +1,434 @@
+#include "Rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <xmmintrin.h>
+
+#include "Camera.h"
+#include "Matrix.h"
+#include "Profiler.h"
+#include "Scene.h"
+#include "Utils.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Vertices closer than this to the camera plane don't project well, those triangles get traced instead
+		constexpr float NearDepth{ 0.001f };
+		//Coverage grows a little past the edges so rounding never opens a crack between neighbouring triangles,
+		//a pixel claimed that way fails the exact hit test and gets traced
+		constexpr float CoverageEpsilon{ 1e-4f };
+
+		constexpr int LocalPixelCount{ Rasterizer::MaxTileSize * Rasterizer::MaxTileSize };
+	}
+
+	void Rasterizer::BeginFrame(const Scene& scene, const Camera& camera, const Projection& projection)
+	{
+		PROFILE_ZONE("Rasterizer::BeginFrame");
+
+		m_Projection = projection;
+		m_NrTilesX = (projection.width + projection.tileSize - 1) / projection.tileSize;
+		const int nrTilesY{ (projection.height + projection.tileSize - 1) / projection.tileSize };
+
+		//Inverse of the pixel to camera mapping
+		m_ScaleX = 0.5f * projection.imageWidth / (projection.aspectRatio * projection.FOV);
+		m_OffsetX = 0.5f * projection.imageWidth - 0.5f - projection.cropX;
+		m_ScaleY = -0.5f * projection.imageHeight / projection.FOV;
+		m_OffsetY = 0.5f * projection.imageHeight - 0.5f - projection.cropY;
+
+		m_CameraOrigin = camera.origin;
+		m_CameraToWorld = camera.cameraToWorld;
+		const Matrix worldToCamera{ Matrix::Inverse(camera.cameraToWorld) };
+
+		m_Triangles.clear();
+		m_NearTriangles.clear();
+		m_Bins.resize(static_cast<size_t>(m_NrTilesX) * nrTilesY);
+		for (std::vector<uint32_t>& bin : m_Bins)
+			bin.clear();
+		m_Samples.resize(static_cast<size_t>(projection.width) * projection.height);
+
+		const std::vector<Sphere>& spheres{ scene.GetSphereGeometries() };
+		m_SphereRects.resize(spheres.size());
+		for (size_t i{ 0 }; i < spheres.size(); ++i)
+		{
+			const Vector3 extent{ spheres[i].radius, spheres[i].radius, spheres[i].radius };
+			m_SphereRects[i] = ProjectBounds(spheres[i].origin - extent, spheres[i].origin + extent, worldToCamera);
+		}
+
+		//Same order as Scene::GetClosestHit so equal depths resolve to the same primitive
+		const std::vector<TriangleMesh>& meshes{ scene.GetTriangleMeshGeometries() };
+		for (size_t i{ 0 }; i < meshes.size(); ++i)
+		{
+			const TriangleMesh& mesh{ meshes[i] };
+			m_CameraPositions.resize(mesh.transformedPositions.size());
+			for (size_t v{ 0 }; v < mesh.transformedPositions.size(); ++v)
+				m_CameraPositions[v] = worldToCamera.TransformPoint(mesh.transformedPositions[v]);
+
+			AddTriangles(m_CameraPositions, mesh.transformedPositions, mesh.transformedNormals, mesh.indices, mesh.cullMode,
+				m_CameraOrigin, PrimitiveType::TriangleMesh, static_cast<unsigned int>(i));
+		}
+
+		//Instances face the camera in object space, like their hit test
+		const std::vector<TriangleMeshInstance>& instances{ scene.GetTriangleMeshInstances() };
+		for (size_t i{ 0 }; i < instances.size(); ++i)
+		{
+			const TriangleMeshInstance& instance{ instances[i] };
+			const MeshData& meshData{ *instance.pMeshData };
+			const Matrix objectToCamera{ instance.worldTransform * worldToCamera };
+
+			m_CameraPositions.resize(meshData.positions.size());
+			for (size_t v{ 0 }; v < meshData.positions.size(); ++v)
+				m_CameraPositions[v] = objectToCamera.TransformPoint(meshData.positions[v]);
+
+			AddTriangles(m_CameraPositions, meshData.positions, meshData.normals, meshData.indices, instance.cullMode,
+				instance.inverseWorldTransform.TransformPoint(m_CameraOrigin), PrimitiveType::TriangleMeshInstance, static_cast<unsigned int>(i));
+		}
+	}
+
+	void Rasterizer::AddTriangles(const std::vector<Vector3>& cameraPositions, const std::vector<Vector3>& facingPositions, const std::vector<Vector3>& normals,
+		const std::vector<int>& indices, TriangleCullMode cullMode, const Vector3& facingOrigin, PrimitiveType primitiveType, unsigned int primitiveIndex)
+	{
+		const int tileSize{ m_Projection.tileSize };
+		const size_t triangleCount{ indices.size() / 3 };
+		for (size_t i{ 0 }; i < triangleCount; ++i)
+		{
+			const int i0{ indices[i * 3] };
+			const int i1{ indices[i * 3 + 1] };
+			const int i2{ indices[i * 3 + 2] };
+
+			//The hit test culls on the ray direction against the stored normal, which is linear over the triangle:
+			//positive where it's visible. Normals don't always match the winding, so a triangle can be culled for part of the screen
+			float facing[3]{};
+			bool isPartlyCulled{ false };
+			if (cullMode != TriangleCullMode::NoCulling)
+			{
+				const float visibleSign{ cullMode == TriangleCullMode::BackFaceCulling ? -1.f : 1.f };
+				const int vertices[3]{ i0, i1, i2 };
+				for (int v{ 0 }; v < 3; ++v)
+					facing[v] = visibleSign * Vector3::Dot(normals[i], facingPositions[vertices[v]] - facingOrigin);
+
+				if (facing[0] < 0.f && facing[1] < 0.f && facing[2] < 0.f)
+					continue;
+
+				isPartlyCulled = facing[0] < 0.f || facing[1] < 0.f || facing[2] < 0.f;
+			}
+
+			const Vector3& c0{ cameraPositions[i0] };
+			const Vector3& c1{ cameraPositions[i1] };
+			const Vector3& c2{ cameraPositions[i2] };
+
+			if (c0.z <= 0.f && c1.z <= 0.f && c2.z <= 0.f)
+				continue;
+
+			const VisibilitySample id{ primitiveIndex, static_cast<unsigned int>(i), primitiveType };
+			if (c0.z < NearDepth || c1.z < NearDepth || c2.z < NearDepth)
+			{
+				m_NearTriangles.push_back(id);
+				continue;
+			}
+
+			float x[3]{}, y[3]{}, inverseDepth[3]{};
+			const Vector3* corners[3]{ &c0, &c1, &c2 };
+			for (int v{ 0 }; v < 3; ++v)
+			{
+				inverseDepth[v] = 1.f / corners[v]->z;
+				x[v] = m_ScaleX * corners[v]->x * inverseDepth[v] + m_OffsetX;
+				y[v] = m_ScaleY * corners[v]->y * inverseDepth[v] + m_OffsetY;
+			}
+
+			//Facing is linear in the perspective correct barycentrics, weighting it by 1 / depth makes it linear in the screen space ones
+			//with the same sign as what the hit test sees
+			if (isPartlyCulled)
+			{
+				for (int v{ 0 }; v < 3; ++v)
+					facing[v] *= inverseDepth[v];
+
+				const float largest{ std::max({ std::abs(facing[0]), std::abs(facing[1]), std::abs(facing[2]) }) };
+				for (float& value : facing)
+					value /= largest;
+			}
+
+			//One pixel of slack on each side for the coverage epsilon
+			const int minX{ std::max(static_cast<int>(std::floor(std::min({ x[0], x[1], x[2] }))) - 1, 0) };
+			const int minY{ std::max(static_cast<int>(std::floor(std::min({ y[0], y[1], y[2] }))) - 1, 0) };
+			const int maxX{ std::min(static_cast<int>(std::ceil(std::max({ x[0], x[1], x[2] }))) + 1, m_Projection.width - 1) };
+			const int maxY{ std::min(static_cast<int>(std::ceil(std::max({ y[0], y[1], y[2] }))) + 1, m_Projection.height - 1) };
+			if (minX > maxX || minY > maxY)
+				continue;
+
+			//Relative to the first covered pixel, keeps the edge functions small and precise
+			for (int v{ 0 }; v < 3; ++v)
+			{
+				x[v] -= static_cast<float>(minX);
+				y[v] -= static_cast<float>(minY);
+			}
+
+			const float area{ (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]) };
+			//Edge on, the hit test's determinant rejects these as well
+			if (std::abs(area) < 1e-12f)
+				continue;
+
+			RasterTriangle triangle{};
+			for (int v{ 0 }; v < 3; ++v)
+			{
+				//Edge opposite the vertex, its edge function over the area is the vertex's weight
+				const int a{ (v + 1) % 3 };
+				const int b{ (v + 2) % 3 };
+				triangle.weights[v].a = -(y[b] - y[a]) / area;
+				triangle.weights[v].b = (x[b] - x[a]) / area;
+				triangle.weights[v].c = ((y[b] - y[a]) * x[a] - (x[b] - x[a]) * y[a]) / area;
+				triangle.inverseDepth[v] = inverseDepth[v];
+				triangle.facing[v] = facing[v];
+			}
+			triangle.isPartlyCulled = isPartlyCulled;
+			triangle.minX = minX;
+			triangle.minY = minY;
+			triangle.maxX = maxX;
+			triangle.maxY = maxY;
+			triangle.primitiveIndex = primitiveIndex;
+			triangle.triangleIndex = static_cast<unsigned int>(i);
+			triangle.primitiveType = primitiveType;
+
+			const uint32_t triangleIndex{ static_cast<uint32_t>(m_Triangles.size()) };
+			m_Triangles.push_back(triangle);
+
+			for (int tileY{ minY / tileSize }; tileY <= maxY / tileSize; ++tileY)
+			{
+				for (int tileX{ minX / tileSize }; tileX <= maxX / tileSize; ++tileX)
+					m_Bins[static_cast<size_t>(tileY) * m_NrTilesX + tileX].push_back(triangleIndex);
+			}
+		}
+	}
+
+	Rasterizer::Rect Rasterizer::ProjectBounds(const Vector3& minAABB, const Vector3& maxAABB, const Matrix& worldToCamera) const
+	{
+		const Rect everything{ 0, 0, m_Projection.width - 1, m_Projection.height - 1 };
+
+		float minX{ FLT_MAX }, minY{ FLT_MAX };
+		float maxX{ -FLT_MAX }, maxY{ -FLT_MAX };
+		int nrCornersInFront{ 0 };
+		for (int corner{ 0 }; corner < 8; ++corner)
+		{
+			const Vector3 cameraPoint{ worldToCamera.TransformPoint(
+				(corner & 1) ? maxAABB.x : minAABB.x,
+				(corner & 2) ? maxAABB.y : minAABB.y,
+				(corner & 4) ? maxAABB.z : minAABB.z) };
+
+			if (cameraPoint.z <= NearDepth)
+				continue;
+
+			++nrCornersInFront;
+			const float rasterX{ m_ScaleX * cameraPoint.x / cameraPoint.z + m_OffsetX };
+			const float rasterY{ m_ScaleY * cameraPoint.y / cameraPoint.z + m_OffsetY };
+			minX = std::min(minX, rasterX);
+			maxX = std::max(maxX, rasterX);
+			minY = std::min(minY, rasterY);
+			maxY = std::max(maxY, rasterY);
+		}
+
+		if (nrCornersInFront == 0)
+			return Rect{ 0, 0, -1, -1 };
+		if (nrCornersInFront < 8)
+			return everything;
+
+		const float limit{ static_cast<float>(std::max(m_Projection.width, m_Projection.height)) + 1.f };
+		return Rect{
+			std::max(static_cast<int>(std::floor(std::max(minX, -1.f))) - 1, everything.minX),
+			std::max(static_cast<int>(std::floor(std::max(minY, -1.f))) - 1, everything.minY),
+			std::min(static_cast<int>(std::ceil(std::min(maxX, limit))) + 1, everything.maxX),
+			std::min(static_cast<int>(std::ceil(std::min(maxY, limit))) + 1, everything.maxY) };
+	}
+
+	Vector3 Rasterizer::GetPixelDirection(int px, int py) const
+	{
+		const float NDCx{ (px + m_Projection.cropX + 0.5f) / m_Projection.imageWidth };
+		const float NDCy{ (py + m_Projection.cropY + 0.5f) / m_Projection.imageHeight };
+
+		const float ScreenX{ 2 * NDCx - 1 };
+		const float ScreenY{ 1 - 2 * NDCy };
+
+		const float CamX{ ScreenX * m_Projection.aspectRatio * m_Projection.FOV };
+		const float CamY{ ScreenY * m_Projection.FOV };
+
+		return m_CameraToWorld.TransformVector(Vector3{ CamX, CamY, 1 });
+	}
+
+	void Rasterizer::RasterizeTile(const Scene& scene, int x, int y, int width, int height)
+	{
+		PROFILE_ZONE("Rasterize Tile");
+
+		//Tile local rows are MaxTileSize long, the padding lets the last 4-wide load of a row run past its end.
+		//Per thread scratch, too big for every worker's stack
+		thread_local std::vector<float> depths(LocalPixelCount + 4);
+		thread_local std::vector<VisibilitySample> samples(LocalPixelCount);
+		std::fill(depths.begin(), depths.end(), FLT_MAX);
+		std::fill(samples.begin(), samples.end(), VisibilitySample{});
+
+		const int endX{ x + width - 1 };
+		const int endY{ y + height - 1 };
+
+		//Spheres and planes are cheap enough to test exactly, on the primary ray itself
+		const std::vector<Sphere>& spheres{ scene.GetSphereGeometries() };
+		const std::vector<Plane>& planes{ scene.GetPlaneGeometries() };
+		for (int py{ y }; py <= endY; ++py)
+		{
+			for (int px{ x }; px <= endX; ++px)
+			{
+				Ray viewRay{ m_CameraOrigin, GetPixelDirection(px, py) };
+				//Back to depth along the unnormalized direction, like the triangles
+				const float inverseLength{ 1.f / viewRay.direction.Normalize() };
+
+				const int local{ (py - y) * MaxTileSize + (px - x) };
+				float t{};
+				for (size_t i{ 0 }; i < spheres.size(); ++i)
+				{
+					const Rect& rect{ m_SphereRects[i] };
+					if (px < rect.minX || px > rect.maxX || py < rect.minY || py > rect.maxY)
+						continue;
+
+					if (GeometryUtils::HitTest_Sphere(spheres[i], viewRay, t))
+					{
+						viewRay.max = t;
+						depths[local] = t * inverseLength;
+						samples[local] = VisibilitySample{ static_cast<unsigned int>(i), 0, PrimitiveType::Sphere };
+					}
+				}
+
+				for (size_t i{ 0 }; i < planes.size(); ++i)
+				{
+					if (GeometryUtils::HitTest_Plane(planes[i], viewRay, t))
+					{
+						viewRay.max = t;
+						depths[local] = t * inverseLength;
+						samples[local] = VisibilitySample{ static_cast<unsigned int>(i), 0, PrimitiveType::Plane };
+					}
+				}
+			}
+		}
+
+		const __m128 laneOffsets{ _mm_setr_ps(0.f, 1.f, 2.f, 3.f) };
+		const __m128 minWeight{ _mm_set1_ps(-CoverageEpsilon) };
+		const __m128 zero{ _mm_setzero_ps() };
+		const __m128 one{ _mm_set1_ps(1.f) };
+
+		const std::vector<uint32_t>& bin{ m_Bins[static_cast<size_t>(y / m_Projection.tileSize) * m_NrTilesX + x / m_Projection.tileSize] };
+		for (const uint32_t triangleIndex : bin)
+		{
+			const RasterTriangle& triangle{ m_Triangles[triangleIndex] };
+			const int startPx{ std::max(triangle.minX, x) }, endPx{ std::min(triangle.maxX, endX) };
+			const int startPy{ std::max(triangle.minY, y) }, endPy{ std::min(triangle.maxY, endY) };
+			if (startPx > endPx || startPy > endPy)
+				continue;
+
+			const __m128 a0{ _mm_set1_ps(triangle.weights[0].a) };
+			const __m128 a1{ _mm_set1_ps(triangle.weights[1].a) };
+			const __m128 a2{ _mm_set1_ps(triangle.weights[2].a) };
+			const __m128 z0{ _mm_set1_ps(triangle.inverseDepth[0]) };
+			const __m128 z1{ _mm_set1_ps(triangle.inverseDepth[1]) };
+			const __m128 z2{ _mm_set1_ps(triangle.inverseDepth[2]) };
+			const __m128 f0{ _mm_set1_ps(triangle.facing[0]) };
+			const __m128 f1{ _mm_set1_ps(triangle.facing[1]) };
+			const __m128 f2{ _mm_set1_ps(triangle.facing[2]) };
+			const VisibilitySample id{ triangle.primitiveIndex, triangle.triangleIndex, triangle.primitiveType };
+
+			for (int py{ startPy }; py <= endPy; ++py)
+			{
+				const float rowY{ static_cast<float>(py - triangle.minY) };
+				const __m128 row0{ _mm_set1_ps(triangle.weights[0].b * rowY + triangle.weights[0].c) };
+				const __m128 row1{ _mm_set1_ps(triangle.weights[1].b * rowY + triangle.weights[1].c) };
+				const __m128 row2{ _mm_set1_ps(triangle.weights[2].b * rowY + triangle.weights[2].c) };
+				const int localRow{ (py - y) * MaxTileSize - x };
+
+				for (int px{ startPx }; px <= endPx; px += 4)
+				{
+					const __m128 columnX{ _mm_add_ps(_mm_set1_ps(static_cast<float>(px - triangle.minX)), laneOffsets) };
+					const __m128 w0{ _mm_add_ps(_mm_mul_ps(a0, columnX), row0) };
+					const __m128 w1{ _mm_add_ps(_mm_mul_ps(a1, columnX), row1) };
+					const __m128 w2{ _mm_add_ps(_mm_mul_ps(a2, columnX), row2) };
+
+					__m128 isInside{ _mm_and_ps(_mm_cmpge_ps(w0, minWeight), _mm_and_ps(_mm_cmpge_ps(w1, minWeight), _mm_cmpge_ps(w2, minWeight))) };
+					if (triangle.isPartlyCulled)
+					{
+						const __m128 facing{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, f0), _mm_mul_ps(w1, f1)), _mm_mul_ps(w2, f2)) };
+						isInside = _mm_and_ps(isInside, _mm_cmpge_ps(facing, minWeight));
+					}
+					if (_mm_movemask_ps(isInside) == 0)
+						continue;
+
+					//Perspective correct: 1 / depth is what's linear on screen
+					const __m128 inverseDepth{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, z0), _mm_mul_ps(w1, z1)), _mm_mul_ps(w2, z2)) };
+					const __m128 depth{ _mm_div_ps(one, inverseDepth) };
+					const __m128 oldDepth{ _mm_loadu_ps(&depths[localRow + px]) };
+					const __m128 isCloser{ _mm_and_ps(_mm_cmplt_ps(depth, oldDepth), _mm_cmpgt_ps(inverseDepth, zero)) };
+
+					//Lanes past the end of the span belong to other triangles' pixels or the padding
+					const int laneMask{ (1 << std::min(endPx - px + 1, 4)) - 1 };
+					const int mask{ _mm_movemask_ps(_mm_and_ps(isInside, isCloser)) & laneMask };
+					if (mask == 0)
+						continue;
+
+					alignas(16) float laneDepths[4];
+					_mm_store_ps(laneDepths, depth);
+					for (int lane{ 0 }; lane < 4; ++lane)
+					{
+						if (!(mask & (1 << lane)))
+							continue;
+
+						depths[localRow + px + lane] = laneDepths[lane];
+						samples[localRow + px + lane] = id;
+					}
+				}
+			}
+		}
+
+		//Rare, so these just get traced with the same unnormalized directions
+		const std::vector<TriangleMesh>& meshes{ scene.GetTriangleMeshGeometries() };
+		const std::vector<TriangleMeshInstance>& instances{ scene.GetTriangleMeshInstances() };
+		for (const VisibilitySample& nearTriangle : m_NearTriangles)
+		{
+			for (int py{ y }; py <= endY; ++py)
+			{
+				for (int px{ x }; px <= endX; ++px)
+				{
+					const int local{ (py - y) * MaxTileSize + (px - x) };
+					Ray ray{ m_CameraOrigin, GetPixelDirection(px, py) };
+					ray.max = depths[local];
+
+					HitCandidate candidate{};
+					const bool didHit{ nearTriangle.primitiveType == PrimitiveType::TriangleMesh
+						? GeometryUtils::HitTest_TriangleMesh(meshes[nearTriangle.primitiveIndex], nearTriangle.triangleIndex, ray, candidate)
+						: GeometryUtils::HitTest_MeshInstance(instances[nearTriangle.primitiveIndex], nearTriangle.triangleIndex, ray, candidate) };
+
+					if (didHit && candidate.t < depths[local])
+					{
+						depths[local] = candidate.t;
+						samples[local] = nearTriangle;
+					}
+				}
+			}
+		}
+
+		for (int py{ y }; py <= endY; ++py)
+			std::copy_n(&samples[(py - y) * MaxTileSize], width, &m_Samples[static_cast<size_t>(py) * m_Projection.width + x]);
+	}
+
+	bool Rasterizer::GetClosestHit(const Scene& scene, unsigned int pixelIndex, const Ray& viewRay, HitRecord& closestHit) const
+	{
+		const VisibilitySample& sample{ m_Samples[pixelIndex] };
+		if (sample.primitiveType == PrimitiveType::None)
+		{
+			//Nothing covered the pixel, but with triangles in its tile that can be a crack along a shared edge
+			const int px{ static_cast<int>(pixelIndex) % m_Projection.width };
+			const int py{ static_cast<int>(pixelIndex) / m_Projection.width };
+			if (!m_Bins[static_cast<size_t>(py / m_Projection.tileSize) * m_NrTilesX + px / m_Projection.tileSize].empty())
+				return false;
+
+			closestHit.t = FLT_MAX;
+			closestHit.didHit = false;
+			return true;
+		}
+
+		return scene.GetPrimitiveHit(viewRay, sample.primitiveType, sample.primitiveIndex, sample.triangleIndex, closestHit);
+	}
+}
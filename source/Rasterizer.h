@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+#include "Math.h"
+
+namespace dae
+{
+	class Scene;
+	struct Camera;
+
+	/**
+	 * Primary visibility without primary rays: triangles are projected once per frame, binned into screen tiles and
+	 * rasterized 4 pixels at a time with SSE edge functions, spheres and planes are solved analytically per pixel.
+	 * What's left per pixel is the closest primitive, a single exact hit test turns that into the HitRecord the ray would have found.
+	 */
+	class Rasterizer final
+	{
+	public:
+		//The renderer's pixel to ray mapping, depth is measured along the camera basis (1 = one forward vector)
+		struct Projection
+		{
+			int width{};
+			int height{};
+			int tileSize{};
+
+			//Image plane the buffer is a window onto
+			int imageWidth{};
+			int imageHeight{};
+			int cropX{};
+			int cropY{};
+			float aspectRatio{};
+			float FOV{};
+		};
+
+		static constexpr int MaxTileSize{ 64 };
+
+		Rasterizer() = default;
+		~Rasterizer() = default;
+
+		Rasterizer(const Rasterizer&) = delete;
+		Rasterizer(Rasterizer&&) noexcept = delete;
+		Rasterizer& operator=(const Rasterizer&) = delete;
+		Rasterizer& operator=(Rasterizer&&) noexcept = delete;
+
+		//Projects and bins every triangle, needs the camera's cameraToWorld to be up to date
+		void BeginFrame(const Scene& scene, const Camera& camera, const Projection& projection);
+		//Closest primitive for each pixel of region, which has to lie inside a single tile. Different tiles can run in parallel
+		void RasterizeTile(const Scene& scene, int x, int y, int width, int height);
+		//Hit of the pixel's primary ray with its rasterized primitive, false when that one doesn't survive the exact test
+		//(e.g. a pixel on a shared edge) or nothing covered a pixel near triangles, and the ray has to be traced against the scene instead
+		bool GetClosestHit(const Scene& scene, unsigned int pixelIndex, const Ray& viewRay, HitRecord& closestHit) const;
+
+	private:
+		struct VisibilitySample
+		{
+			unsigned int primitiveIndex{};
+			unsigned int triangleIndex{};
+			PrimitiveType primitiveType{ PrimitiveType::None };
+		};
+
+		//Barycentric weight of one vertex as a plane over the raster, relative to the triangle's origin pixel
+		struct WeightPlane
+		{
+			float a{};
+			float b{};
+			float c{};
+		};
+
+		struct RasterTriangle
+		{
+			WeightPlane weights[3]{};
+			//1 / depth per vertex, interpolates linearly on screen
+			float inverseDepth[3]{};
+			//Which side the rays see times 1 / depth, per vertex and scaled to at most 1. Only used when the triangle is culled for part of the screen
+			float facing[3]{};
+			bool isPartlyCulled{ false };
+
+			int minX{}, minY{}, maxX{}, maxY{};
+
+			unsigned int primitiveIndex{};
+			unsigned int triangleIndex{};
+			PrimitiveType primitiveType{};
+		};
+
+		//Raster rectangle, inclusive
+		struct Rect
+		{
+			int minX{}, minY{}, maxX{}, maxY{};
+		};
+
+		Projection m_Projection{};
+		int m_NrTilesX{};
+
+		//Camera space to raster, pixel centers are on whole numbers
+		float m_ScaleX{};
+		float m_OffsetX{};
+		float m_ScaleY{};
+		float m_OffsetY{};
+
+		Vector3 m_CameraOrigin{};
+		Matrix m_CameraToWorld{};
+
+		std::vector<RasterTriangle> m_Triangles{};
+		//Indices into m_Triangles per tile, in the order GetClosestHit tests them
+		std::vector<std::vector<uint32_t>> m_Bins{};
+		//Triangles touching the camera plane don't project, every pixel traces these
+		std::vector<VisibilitySample> m_NearTriangles{};
+		//Empty when the sphere can't be seen
+		std::vector<Rect> m_SphereRects{};
+
+		std::vector<VisibilitySample> m_Samples{};
+
+		//Scratch for the camera space positions of one mesh
+		std::vector<Vector3> m_CameraPositions{};
+
+		void AddTriangles(const std::vector<Vector3>& cameraPositions, const std::vector<Vector3>& facingPositions, const std::vector<Vector3>& normals,
+			const std::vector<int>& indices, TriangleCullMode cullMode, const Vector3& facingOrigin, PrimitiveType primitiveType, unsigned int primitiveIndex);
+		Rect ProjectBounds(const Vector3& minAABB, const Vector3& maxAABB, const Matrix& worldToCamera) const;
+		//Unnormalized direction through a pixel center with the same float operations as Renderer::RenderPixel,
+		//normalized it's exactly the primary ray so ties between spheres and planes resolve alike
+		Vector3 GetPixelDirection(int px, int py) const;
+	};
+}
@@ -0,0 +1,73 @@
+#include "RayStats.h"
+
+#include <deque>
+#include <mutex>
+
+namespace dae
+{
+	namespace RayStats
+	{
+		namespace
+		{
+			//Deque keeps the addresses stable, slots outlive their threads so nothing ever dangles
+			std::mutex g_RegistryMutex{};
+			std::deque<ThreadCounters> g_ThreadCounters{};
+
+			Totals g_FrameTotals{};
+		}
+
+		Totals& Totals::operator+=(const Totals& other)
+		{
+			for (int i{ 0 }; i < CounterCount; ++i)
+				values[i] += other.values[i];
+
+			return *this;
+		}
+
+		ThreadCounters* RegisterThread()
+		{
+			const std::lock_guard<std::mutex> lock{ g_RegistryMutex };
+			return &g_ThreadCounters.emplace_back();
+		}
+
+		void BeginFrame()
+		{
+			const std::lock_guard<std::mutex> lock{ g_RegistryMutex };
+			for (ThreadCounters& counters : g_ThreadCounters)
+				counters = {};
+		}
+
+		void EndFrame()
+		{
+			const std::lock_guard<std::mutex> lock{ g_RegistryMutex };
+
+			g_FrameTotals = {};
+			for (const ThreadCounters& counters : g_ThreadCounters)
+			{
+				for (int i{ 0 }; i < CounterCount; ++i)
+					g_FrameTotals.values[i] += counters.values[i];
+			}
+		}
+
+		const Totals& GetFrameTotals()
+		{
+			return g_FrameTotals;
+		}
+
+		const char* GetName(Counter counter)
+		{
+			switch (counter)
+			{
+			case Counter::PrimaryHits: return "primaryHits";
+			case Counter::ShadowHits: return "shadowHits";
+			case Counter::SlabTests: return "slabTests";
+			case Counter::SphereTests: return "sphereTests";
+			case Counter::PlaneTests: return "planeTests";
+			case Counter::TriangleTests: return "triangleTests";
+			case Counter::OccluderCacheLookups: return "occluderCacheLookups";
+			case Counter::OccluderCacheHits: return "occluderCacheHits";
+			default: return "unknown";
+			}
+		}
+	}
+}
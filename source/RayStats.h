@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+
+//Counters only exist in Debug builds, define RAY_STATISTICS to get them in Release too
+#if defined(_DEBUG) && !defined(RAY_STATISTICS)
+#define RAY_STATISTICS
+#endif
+
+namespace dae
+{
+	namespace RayStats
+	{
+		//Rays traced are always counted by the renderer (GetPrimaryRayCount, GetShadowRayCount), only what they ran into is here
+		enum class Counter
+		{
+			PrimaryHits,
+			ShadowHits,
+			SlabTests,
+			SphereTests,
+			PlaneTests,
+			TriangleTests,
+			OccluderCacheLookups, //Shadow rays that had a cached occluder to try first
+			OccluderCacheHits, //Shadow rays the cached occluder blocked, no traversal needed
+
+			Count
+		};
+
+		constexpr int CounterCount{ static_cast<int>(Counter::Count) };
+
+		struct Totals
+		{
+			uint64_t values[CounterCount]{};
+
+			uint64_t Get(Counter counter) const { return values[static_cast<int>(counter)]; }
+			Totals& operator+=(const Totals& other);
+		};
+
+		//One per thread, padded to a cache line so threads never write to the same line
+		struct alignas(64) ThreadCounters
+		{
+			uint64_t values[CounterCount]{};
+		};
+
+		ThreadCounters* RegisterThread();
+
+		inline ThreadCounters& GetThreadCounters()
+		{
+			static thread_local ThreadCounters* pCounters{ RegisterThread() };
+			return *pCounters;
+		}
+
+		inline void Increment(Counter counter, uint64_t amount = 1)
+		{
+			GetThreadCounters().values[static_cast<int>(counter)] += amount;
+		}
+
+		//Only call these while no thread is tracing
+		void BeginFrame();
+		void EndFrame();
+
+		const Totals& GetFrameTotals();
+		const char* GetName(Counter counter);
+	}
+}
+
+#ifdef RAY_STATISTICS
+#define RAY_STAT(counter) dae::RayStats::Increment(dae::RayStats::Counter::counter)
+#define RAY_STATS(counter, amount) dae::RayStats::Increment(dae::RayStats::Counter::counter, amount)
+#else
+#define RAY_STAT(counter) ((void)0)
+#define RAY_STATS(counter, amount) ((void)0)
+#endif
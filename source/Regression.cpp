@@ -0,0 +1,411 @@
+#include "Regression.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include "Renderer.h"
+#include "Scene.h"
+#include "Timer.h"
+
+namespace dae
+{
+	namespace Regression
+	{
+		namespace
+		{
+			struct Image
+			{
+				int width{};
+				int height{};
+				std::vector<uint8_t> rgb{};
+			};
+
+			struct Comparison
+			{
+				double psnr{};
+				double differentPixels{};
+				int maxDifference{};
+				double perceptualError{};
+			};
+
+			//One image per scene and time, anything not set here renders with the renderer's defaults
+			struct RenderVariant
+			{
+				std::string name{};
+				Renderer::LightingMode lightingMode{ Renderer::LightingMode::Combined };
+				bool shadowsEnabled{ true };
+				Renderer::PrimaryVisibility primaryVisibility{ Renderer::PrimaryVisibility::RayTraced };
+				Renderer::LightSampling lightSampling{ Renderer::LightSampling::AllLights };
+				bool lightmap{ false };
+				//Updates the frame one time step earlier instead of rendering from scratch
+				bool incremental{ false };
+			};
+
+			struct Lab
+			{
+				float L{};
+				float a{};
+				float b{};
+			};
+
+			//Binary PPM, no dependencies and every image viewer opens it
+			bool WritePPM(const std::string& filename, const Image& image)
+			{
+				std::ofstream file(filename, std::ios::binary);
+				if (!file)
+					return false;
+
+				file << "P6\n" << image.width << " " << image.height << "\n255\n";
+				file.write(reinterpret_cast<const char*>(image.rgb.data()), image.rgb.size());
+				return static_cast<bool>(file);
+			}
+
+			bool ReadPPM(const std::string& filename, Image& image)
+			{
+				std::ifstream file(filename, std::ios::binary);
+				if (!file)
+					return false;
+
+				std::string magic{};
+				int maxValue{};
+				file >> magic >> image.width >> image.height >> maxValue;
+				if (magic != "P6" || maxValue != 255 || image.width <= 0 || image.height <= 0)
+					return false;
+
+				//Single whitespace between the header and the data
+				file.get();
+
+				image.rgb.resize(static_cast<size_t>(image.width) * image.height * 3);
+				file.read(reinterpret_cast<char*>(image.rgb.data()), image.rgb.size());
+				return static_cast<bool>(file);
+			}
+
+			float ToLinear(uint8_t value)
+			{
+				const float color{ value / 255.f };
+				return color <= 0.04045f ? color / 12.92f : std::pow((color + 0.055f) / 1.055f, 2.4f);
+			}
+
+			//Linear sRGB > CIELAB, D65 white
+			Lab ToLab(float r, float g, float b)
+			{
+				const float x{ (0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.9505f };
+				const float y{ 0.2126f * r + 0.7152f * g + 0.0722f * b };
+				const float z{ (0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.089f };
+
+				const auto f = [](float t) { return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.f / 116.f; };
+				const float fx{ f(x) };
+				const float fy{ f(y) };
+				const float fz{ f(z) };
+				return Lab{ 116.f * fy - 16.f, 500.f * (fx - fy), 200.f * (fy - fz) };
+			}
+
+			//Lightness and chroma apart, large colour differences stay closer to what people see than with plain Euclidean distance
+			float HyAB(const Lab& a, const Lab& b)
+			{
+				return std::abs(a.L - b.L) + std::sqrt((a.a - b.a) * (a.a - b.a) + (a.b - b.b) * (a.b - b.b));
+			}
+
+			//Linear RGB blurred with a 5 x 5 gaussian (sigma 1 pixel), then converted to CIELAB
+			std::vector<Lab> GetFilteredLab(const Image& image)
+			{
+				constexpr int Radius{ 2 };
+				constexpr float Weights[]{ 0.0545f, 0.2442f, 0.4026f, 0.2442f, 0.0545f };
+
+				const size_t pixelCount{ static_cast<size_t>(image.width) * image.height };
+				std::vector<float> linear(pixelCount * 3);
+				for (size_t i{ 0 }; i < linear.size(); ++i)
+					linear[i] = ToLinear(image.rgb[i]);
+
+				//Separable, edges clamp
+				const auto blur = [&](const std::vector<float>& source, int stepX, int stepY)
+					{
+						std::vector<float> blurred(source.size());
+						for (int y{ 0 }; y < image.height; ++y)
+						{
+							for (int x{ 0 }; x < image.width; ++x)
+							{
+								for (int channel{ 0 }; channel < 3; ++channel)
+								{
+									float sum{};
+									for (int offset{ -Radius }; offset <= Radius; ++offset)
+									{
+										const int sampleX{ std::clamp(x + offset * stepX, 0, image.width - 1) };
+										const int sampleY{ std::clamp(y + offset * stepY, 0, image.height - 1) };
+										sum += Weights[offset + Radius] * source[(static_cast<size_t>(sampleY) * image.width + sampleX) * 3 + channel];
+									}
+									blurred[(static_cast<size_t>(y) * image.width + x) * 3 + channel] = sum;
+								}
+							}
+						}
+						return blurred;
+					};
+				const std::vector<float> filtered{ blur(blur(linear, 1, 0), 0, 1) };
+
+				std::vector<Lab> lab(pixelCount);
+				for (size_t i{ 0 }; i < pixelCount; ++i)
+					lab[i] = ToLab(filtered[i * 3], filtered[i * 3 + 1], filtered[i * 3 + 2]);
+
+				return lab;
+			}
+
+			//Colour term of FLIP (Andersson et al. 2020): spatially filtered HyAB in CIELAB, compressed and remapped to 0..1.
+			//Simplified: one fixed blur instead of the viewing distance dependent contrast sensitivity filters, no Hunt adjustment
+			//and no edge/point feature term, so it mostly tracks visible colour and brightness shifts, not added or lost fine detail
+			double GetPerceptualError(const Image& reference, const Image& result)
+			{
+				constexpr float Exponent{ 0.7f };
+				constexpr float CutoffFraction{ 0.4f };
+				constexpr float CutoffError{ 0.95f };
+
+				//Largest difference FLIP normalizes against, pure green vs pure blue
+				const float maxError{ std::pow(HyAB(ToLab(0.f, 1.f, 0.f), ToLab(0.f, 0.f, 1.f)), Exponent) };
+				const float cutoff{ CutoffFraction * maxError };
+
+				const std::vector<Lab> referenceLab{ GetFilteredLab(reference) };
+				const std::vector<Lab> resultLab{ GetFilteredLab(result) };
+
+				double totalError{};
+				for (size_t i{ 0 }; i < referenceLab.size(); ++i)
+				{
+					const float error{ std::pow(HyAB(referenceLab[i], resultLab[i]), Exponent) };
+					//Small differences get most of the range, everything past the cutoff is squeezed into the rest
+					const float mapped{ error < cutoff ? error * CutoffError / cutoff
+						: CutoffError + (error - cutoff) / (maxError - cutoff) * (1.f - CutoffError) };
+					totalError += std::min(mapped, 1.f);
+				}
+
+				return referenceLab.empty() ? 0.0 : totalError / referenceLab.size();
+			}
+
+			Comparison CompareImages(const Image& reference, const Image& result, int pixelTolerance)
+			{
+				Comparison comparison{};
+
+				double squaredError{};
+				size_t differentPixels{};
+				for (size_t i{ 0 }; i < reference.rgb.size(); i += 3)
+				{
+					int pixelDifference{};
+					for (size_t channel{ 0 }; channel < 3; ++channel)
+					{
+						const int difference{ std::abs(reference.rgb[i + channel] - result.rgb[i + channel]) };
+						pixelDifference = std::max(pixelDifference, difference);
+						squaredError += static_cast<double>(difference) * difference;
+					}
+
+					comparison.maxDifference = std::max(comparison.maxDifference, pixelDifference);
+					if (pixelDifference > pixelTolerance)
+						++differentPixels;
+				}
+
+				const double pixelCount{ static_cast<double>(reference.rgb.size() / 3) };
+				const double meanSquaredError{ squaredError / reference.rgb.size() };
+
+				comparison.differentPixels = differentPixels / pixelCount;
+				comparison.psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+				comparison.perceptualError = GetPerceptualError(reference, result);
+				return comparison;
+			}
+
+			//Absolute difference, amplified so small errors stay visible
+			Image CreateDiffImage(const Image& reference, const Image& result)
+			{
+				Image diff{ reference.width, reference.height, std::vector<uint8_t>(reference.rgb.size()) };
+				for (size_t i{ 0 }; i < reference.rgb.size(); ++i)
+					diff.rgb[i] = static_cast<uint8_t>(std::min(std::abs(reference.rgb[i] - result.rgb[i]) * 8, 255));
+
+				return diff;
+			}
+
+			const char* GetLightingModeName(Renderer::LightingMode mode)
+			{
+				switch (mode)
+				{
+				case Renderer::LightingMode::ObservedArea:
+					return "ObservedArea";
+				case Renderer::LightingMode::Radiance:
+					return "Radiance";
+				case Renderer::LightingMode::BRDF:
+					return "BRDF";
+				default:
+					return "Combined";
+				}
+			}
+
+			std::vector<RenderVariant> GetRenderVariants()
+			{
+				constexpr Renderer::LightingMode lightingModes[]{ Renderer::LightingMode::ObservedArea, Renderer::LightingMode::Radiance,
+					Renderer::LightingMode::BRDF, Renderer::LightingMode::Combined };
+
+				std::vector<RenderVariant> variants{};
+				for (const Renderer::LightingMode lightingMode : lightingModes)
+				{
+					for (const bool shadowsEnabled : { false, true })
+						variants.push_back(RenderVariant{ std::string(GetLightingModeName(lightingMode)) + (shadowsEnabled ? "_Shadows" : "_NoShadows"), lightingMode, shadowsEnabled });
+				}
+
+				//The other paths to the full image, each against its own reference
+				RenderVariant rasterized{ "Combined_Shadows_Rasterized" };
+				rasterized.primaryVisibility = Renderer::PrimaryVisibility::Rasterized;
+				variants.push_back(rasterized);
+
+				RenderVariant lightTree{ "Combined_Shadows_LightTree" };
+				lightTree.lightSampling = Renderer::LightSampling::Importance;
+				variants.push_back(lightTree);
+
+				RenderVariant lightmap{ "Combined_Shadows_Lightmap" };
+				lightmap.lightmap = true;
+				variants.push_back(lightmap);
+
+				RenderVariant incremental{ "Combined_Shadows_Incremental" };
+				incremental.incremental = true;
+				variants.push_back(incremental);
+
+				return variants;
+			}
+
+			void UpdateScene(Scene* pScene, float time, float timeStep)
+			{
+				Timer timer{};
+				timer.SetSimulatedTime(time, timeStep);
+				pScene->Update(&timer);
+			}
+
+			//Leaves the scene at time, returns how long the measured render took
+			double RenderVariantImage(Renderer& renderer, Scene* pScene, const RenderVariant& variant, float time, float timeStep)
+			{
+				renderer.SetLightingMode(variant.lightingMode);
+				renderer.SetShadowsEnabled(variant.shadowsEnabled);
+				renderer.SetPrimaryVisibility(variant.primaryVisibility);
+				renderer.SetLightSampling(variant.lightSampling);
+
+				if (variant.lightmap)
+					renderer.BakeLightmap(pScene);
+
+				//Full frame a step earlier first, only the update on top of it is measured and compared
+				if (variant.incremental)
+				{
+					UpdateScene(pScene, time - timeStep, timeStep);
+					renderer.RenderIncremental(pScene);
+					UpdateScene(pScene, time, timeStep);
+				}
+
+				const auto start = std::chrono::steady_clock::now();
+				if (variant.incremental)
+					renderer.RenderIncremental(pScene);
+				else
+					renderer.Render(pScene);
+				const auto end = std::chrono::steady_clock::now();
+
+				if (variant.lightmap)
+					renderer.ClearLightmap();
+
+				return std::chrono::duration<double, std::milli>(end - start).count();
+			}
+		}
+
+		int RunGoldenImageTest(const GoldenImageSettings& settings)
+		{
+			std::cout << "**GOLDEN IMAGE TEST STARTED** " << settings.width << "x" << settings.height
+				<< (settings.updateReferences ? ", updating references in " : ", comparing against ") << settings.directory << "\n";
+
+			std::error_code error{};
+			std::filesystem::create_directories(settings.directory, error);
+
+			Renderer renderer{ settings.width, settings.height };
+			if (!renderer.IsValid())
+				return 1;
+
+			constexpr float TimeStep{ 1.f / 30.f };
+			const std::vector<RenderVariant> variants{ GetRenderVariants() };
+
+			std::cout << std::fixed << std::setprecision(2);
+			std::cout << std::left << std::setw(64) << "IMAGE" << std::setw(9) << "RESULT"
+				<< std::right << std::setw(9) << "PSNR" << std::setw(10) << "DIFF %" << std::setw(6) << "MAX" << std::setw(8) << "FLIP" << std::setw(10) << "MS" << "\n";
+
+			int passed{};
+			int failed{};
+			double totalMs{};
+			for (const SceneFactory& factory : GetSceneFactories())
+			{
+				if (!settings.sceneFilter.empty() && std::string(factory.name).find(settings.sceneFilter) == std::string::npos)
+					continue;
+
+				const std::unique_ptr<Scene> pScene = factory.create();
+				pScene->Initialize();
+
+				for (const float time : settings.times)
+				{
+					UpdateScene(pScene.get(), time, TimeStep);
+
+					for (const RenderVariant& variant : variants)
+					{
+						const double renderMs{ RenderVariantImage(renderer, pScene.get(), variant, time, TimeStep) };
+						totalMs += renderMs;
+
+						const std::string name{ std::string(factory.name) + "_" + variant.name + "_t" + std::to_string(std::lround(time * 1000.f)) };
+						const std::string filename{ settings.directory + "/" + name + ".ppm" };
+						const Image result{ settings.width, settings.height, renderer.GetBufferRGB() };
+
+						std::cout << std::left << std::setw(64) << name;
+
+						if (settings.updateReferences)
+						{
+							const bool isWritten{ WritePPM(filename, result) };
+							std::cout << std::setw(9) << (isWritten ? "UPDATED" : "FAILED") << std::right << std::setw(43) << renderMs << "\n";
+							isWritten ? ++passed : ++failed;
+							continue;
+						}
+
+						Image reference{};
+						if (!ReadPPM(filename, reference))
+						{
+							std::cout << std::setw(9) << "MISSING" << std::right << std::setw(43) << renderMs << "\n";
+							++failed;
+							continue;
+						}
+
+						if (reference.width != result.width || reference.height != result.height)
+						{
+							std::cout << std::setw(9) << "SIZE" << std::right << std::setw(43) << renderMs << "\n";
+							++failed;
+							continue;
+						}
+
+						const Comparison comparison{ CompareImages(reference, result, settings.pixelTolerance) };
+						const bool isPassed{ comparison.differentPixels <= settings.maxDifferentPixels && comparison.psnr >= settings.minPSNR
+							&& comparison.perceptualError <= settings.maxPerceptualError };
+
+						std::cout << std::setw(9) << (isPassed ? "PASS" : "FAIL") << std::right
+							<< std::setw(9) << comparison.psnr
+							<< std::setw(10) << comparison.differentPixels * 100.0
+							<< std::setw(6) << comparison.maxDifference
+							<< std::setw(8) << std::setprecision(4) << comparison.perceptualError << std::setprecision(2)
+							<< std::setw(10) << renderMs << "\n";
+
+						if (isPassed)
+						{
+							++passed;
+							continue;
+						}
+
+						++failed;
+						WritePPM(settings.directory + "/" + name + ".diff.ppm", CreateDiffImage(reference, result));
+					}
+				}
+			}
+
+			std::cout << "**GOLDEN IMAGE TEST FINISHED** " << passed << " passed, " << failed << " failed, "
+				<< totalMs << " ms rendering" << std::endl;
+			return failed;
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	namespace Regression
+	{
+		struct GoldenImageSettings
+		{
+			int width{ 320 };
+			int height{ 240 };
+
+			//Every scene gets rendered at each of these simulated times
+			std::vector<float> times{ 0.f, 2.5f };
+
+			std::string directory{ "Resources/Golden" };
+			//Only scenes whose name contains this, empty runs all of them
+			std::string sceneFilter{};
+
+			//Overwrite the references with the current output instead of comparing
+			bool updateReferences{ false };
+
+			//A pixel counts as different once any channel is off by more than this
+			int pixelTolerance{ 2 };
+			//An image fails when more than this fraction of its pixels differ, its PSNR drops below minPSNR
+			//or its mean perceptual (FLIP style, 0 to 1) error goes above maxPerceptualError
+			float maxDifferentPixels{ 0.001f };
+			float minPSNR{ 40.f };
+			float maxPerceptualError{ 0.01f };
+		};
+
+		/**
+		 * \brief Renders every scene in every LightingMode, with shadows on and off, plus Combined with shadows through rasterized
+		 * primary visibility, light tree sampling, the lightmap and an incremental update, and compares against the stored reference images
+		 * \param settings Resolution, simulated times and tolerances
+		 * \return Number of failed or missing images, 0 when everything matches
+		 */
+		int RunGoldenImageTest(const GoldenImageSettings& settings);
+	}
+}
@@ -0,0 +1,299 @@
+#include "RenderServer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "Profiler.h"
+#include "Timer.h"
+
+namespace dae
+{
+	namespace
+	{
+		bool ParseVector3(const std::string& value, Vector3& vector)
+		{
+			std::string spaced{ value };
+			std::replace(spaced.begin(), spaced.end(), ',', ' ');
+
+			std::istringstream stream{ spaced };
+			return static_cast<bool>(stream >> vector.x >> vector.y >> vector.z);
+		}
+
+		bool ParseRegion(const std::string& value, Renderer::Region& region)
+		{
+			std::string spaced{ value };
+			std::replace(spaced.begin(), spaced.end(), ',', ' ');
+
+			std::istringstream stream{ spaced };
+			return static_cast<bool>(stream >> region.x >> region.y >> region.width >> region.height);
+		}
+
+		bool ParseLightingMode(const std::string& value, Renderer::LightingMode& mode)
+		{
+			if (value == "ObservedArea")
+				mode = Renderer::LightingMode::ObservedArea;
+			else if (value == "Radiance")
+				mode = Renderer::LightingMode::Radiance;
+			else if (value == "BRDF")
+				mode = Renderer::LightingMode::BRDF;
+			else if (value == "Combined")
+				mode = Renderer::LightingMode::Combined;
+			else
+				return false;
+
+			return true;
+		}
+	}
+
+	RenderServer::RenderServer(size_t memoryBudget) :
+		m_MemoryBudget(memoryBudget)
+	{
+	}
+
+	RenderServer::~RenderServer() = default;
+
+	void RenderServer::Run(std::istream& input, std::ostream& output)
+	{
+		output << "ready" << std::endl;
+
+		std::string line{};
+		while (std::getline(input, line))
+		{
+			std::istringstream stream{ line };
+			std::string command{};
+			stream >> command;
+
+			if (command.empty())
+				continue;
+
+			if (command == "quit")
+				break;
+
+			if (command == "stats")
+			{
+				output << "ok scenes=" << m_Scenes.size() << " memory=" << m_MemoryUsage << " budget=" << m_MemoryBudget
+					<< " hits=" << m_CacheHits << " misses=" << m_CacheMisses << std::endl;
+				continue;
+			}
+
+			if (command != "render")
+			{
+				output << "error unknown command " << command << std::endl;
+				continue;
+			}
+
+			std::string arguments{};
+			std::getline(stream, arguments);
+
+			RenderJob job{};
+			std::string error{};
+			if (!ParseJob(arguments, job, error))
+			{
+				output << "error " << error << std::endl;
+				continue;
+			}
+
+			output << RunJob(job) << std::endl;
+		}
+	}
+
+	RenderServer::CachedScene* RenderServer::AcquireScene(const std::string& sceneName, bool& wasCached)
+	{
+		for (auto it = m_Scenes.begin(); it != m_Scenes.end(); ++it)
+		{
+			if (it->name != sceneName)
+				continue;
+
+			//Move to the front, list iterators stay valid
+			m_Scenes.splice(m_Scenes.begin(), m_Scenes, it);
+			wasCached = true;
+			++m_CacheHits;
+			return &m_Scenes.front();
+		}
+
+		for (const SceneFactory& factory : GetSceneFactories())
+		{
+			if (sceneName != factory.name)
+				continue;
+
+			PROFILE_ZONE("RenderServer::LoadScene");
+
+			CachedScene cachedScene{};
+			cachedScene.name = sceneName;
+			cachedScene.pScene = factory.create();
+			cachedScene.pScene->Initialize();
+			cachedScene.initialCamera = cachedScene.pScene->GetCamera();
+			cachedScene.memoryUsage = cachedScene.pScene->GetMemoryUsage();
+
+			m_MemoryUsage += cachedScene.memoryUsage;
+			m_Scenes.push_front(std::move(cachedScene));
+			EvictScenes();
+
+			wasCached = false;
+			++m_CacheMisses;
+			return &m_Scenes.front();
+		}
+
+		return nullptr;
+	}
+
+	void RenderServer::EvictScenes()
+	{
+		//The front one is about to be rendered, it stays even when it's over budget on its own
+		while (m_MemoryUsage > m_MemoryBudget && m_Scenes.size() > 1)
+		{
+			m_MemoryUsage -= m_Scenes.back().memoryUsage;
+			m_Scenes.pop_back();
+		}
+	}
+
+	bool RenderServer::ParseJob(const std::string& arguments, RenderJob& job, std::string& error) const
+	{
+		std::istringstream stream{ arguments };
+		std::string argument{};
+		while (stream >> argument)
+		{
+			const size_t separator{ argument.find('=') };
+			if (separator == std::string::npos)
+			{
+				error = "expected key=value, got " + argument;
+				return false;
+			}
+
+			const std::string key{ argument.substr(0, separator) };
+			const std::string value{ argument.substr(separator + 1) };
+
+			bool isValid{ true };
+			try
+			{
+				if (key == "scene")
+					job.sceneName = value;
+				else if (key == "output")
+					job.outputFile = value;
+				else if (key == "width")
+					job.width = std::stoi(value);
+				else if (key == "height")
+					job.height = std::stoi(value);
+				else if (key == "time")
+					job.time = std::stof(value);
+				else if (key == "shadows")
+					job.shadowsEnabled = value != "0";
+				else if (key == "lighting")
+					isValid = ParseLightingMode(value, job.lightingMode);
+				else if (key == "camera")
+					isValid = job.hasCameraOrigin = ParseVector3(value, job.cameraOrigin);
+				else if (key == "forward")
+					isValid = job.hasCameraForward = ParseVector3(value, job.cameraForward) && job.cameraForward.SqrMagnitude() > 0.f;
+				else if (key == "fov")
+				{
+					job.fovAngle = std::stof(value);
+					isValid = job.hasFovAngle = job.fovAngle > 0.f && job.fovAngle < 180.f;
+				}
+				else if (key == "crop")
+					isValid = job.hasCrop = ParseRegion(value, job.crop);
+				else
+				{
+					error = "unknown key " + key;
+					return false;
+				}
+			}
+			catch (const std::exception&)
+			{
+				isValid = false;
+			}
+
+			if (!isValid)
+			{
+				error = "invalid value for " + key;
+				return false;
+			}
+		}
+
+		if (job.sceneName.empty())
+		{
+			error = "missing scene";
+			return false;
+		}
+
+		if (job.width <= 0 || job.height <= 0)
+		{
+			error = "invalid resolution";
+			return false;
+		}
+
+		if (job.hasCrop && (job.crop.x < 0 || job.crop.y < 0 || job.crop.width <= 0 || job.crop.height <= 0
+			|| job.crop.x + job.crop.width > job.width || job.crop.y + job.crop.height > job.height))
+		{
+			error = "crop outside the image";
+			return false;
+		}
+
+		return true;
+	}
+
+	std::string RenderServer::RunJob(const RenderJob& job)
+	{
+		PROFILE_ZONE("RenderServer::RunJob");
+
+		const auto start = std::chrono::steady_clock::now();
+
+		bool wasCached{};
+		CachedScene* pCachedScene{ AcquireScene(job.sceneName, wasCached) };
+		if (!pCachedScene)
+			return "error unknown scene " + job.sceneName;
+
+		//A cropped job only allocates and traces its window of the image
+		const int bufferWidth{ job.hasCrop ? job.crop.width : job.width };
+		const int bufferHeight{ job.hasCrop ? job.crop.height : job.height };
+		if (!m_pRenderer || m_pRenderer->GetWidth() != bufferWidth || m_pRenderer->GetHeight() != bufferHeight)
+		{
+			m_pRenderer = std::make_unique<Renderer>(bufferWidth, bufferHeight);
+			if (!m_pRenderer->IsValid())
+			{
+				m_pRenderer.reset();
+				return "error could not create a " + std::to_string(bufferWidth) + "x" + std::to_string(bufferHeight) + " render buffer";
+			}
+		}
+
+		if (job.hasCrop)
+			m_pRenderer->SetCropWindow(job.width, job.height, job.crop.x, job.crop.y);
+		else
+			m_pRenderer->ResetCropWindow();
+
+		m_pRenderer->SetShadowsEnabled(job.shadowsEnabled);
+		m_pRenderer->SetLightingMode(job.lightingMode);
+
+		Scene* pScene{ pCachedScene->pScene.get() };
+		pScene->GetCamera() = pCachedScene->initialCamera;
+
+		//Never started, the scene only sees the job's time
+		Timer timer{};
+		timer.SetSimulatedTime(job.time, 0.f);
+		pScene->Update(&timer);
+
+		Camera& camera{ pScene->GetCamera() };
+		if (job.hasCameraOrigin)
+			camera.origin = job.cameraOrigin;
+		if (job.hasCameraForward)
+			camera.forward = job.cameraForward.Normalized();
+		if (job.hasFovAngle)
+			camera.SetFovAngle(job.fovAngle);
+
+		m_pRenderer->Render(pScene);
+
+		//SDL_SaveBMP returns 0 on success
+		if (m_pRenderer->SaveBufferToImage(job.outputFile))
+			return "error could not write " + job.outputFile;
+
+		const auto end = std::chrono::steady_clock::now();
+
+		std::ostringstream reply{};
+		reply << std::fixed << std::setprecision(2) << "ok output=" << job.outputFile
+			<< " ms=" << std::chrono::duration<double, std::milli>(end - start).count()
+			<< " scene=" << (wasCached ? "cached" : "loaded");
+		return reply.str();
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <iosfwd>
+#include <list>
+#include <memory>
+#include <string>
+
+#include "Camera.h"
+#include "Renderer.h"
+#include "Scene.h"
+
+namespace dae
+{
+	struct RenderJob
+	{
+		std::string sceneName{};
+		std::string outputFile{ "render.bmp" };
+
+		int width{ 640 };
+		int height{ 480 };
+
+		//Scene time the scene gets updated to before rendering
+		float time{ 0.f };
+		bool shadowsEnabled{ true };
+		Renderer::LightingMode lightingMode{ Renderer::LightingMode::Combined };
+
+		//Camera the scene starts with, each part only overridden when its key was given
+		bool hasCameraOrigin{ false };
+		Vector3 cameraOrigin{};
+		bool hasCameraForward{ false };
+		Vector3 cameraForward{ Vector3::UnitZ };
+		bool hasFovAngle{ false };
+		float fovAngle{ 45.f };
+
+		//Only this window of the width x height image gets rendered, the output is the window's size
+		bool hasCrop{ false };
+		Renderer::Region crop{};
+	};
+
+	//Long lived process that renders jobs read line by line, initialized scenes are kept in an LRU cache
+	class RenderServer final
+	{
+	public:
+		explicit RenderServer(size_t memoryBudget);
+		~RenderServer();
+
+		RenderServer(const RenderServer&) = delete;
+		RenderServer(RenderServer&&) noexcept = delete;
+		RenderServer& operator=(const RenderServer&) = delete;
+		RenderServer& operator=(RenderServer&&) noexcept = delete;
+
+		/**
+		 * \brief Handles one command per line until "quit" or the end of input, every command gets exactly one reply line
+		 *
+		 * render scene=<name> [output=<file.bmp>] [width=<int>] [height=<int>] [time=<seconds>] [shadows=0|1]
+		 *        [lighting=ObservedArea|Radiance|BRDF|Combined] [camera=x,y,z] [forward=x,y,z] [fov=<degrees>]
+		 *        [crop=x,y,width,height]
+		 * stats
+		 * quit
+		 */
+		void Run(std::istream& input, std::ostream& output);
+
+	private:
+		struct CachedScene
+		{
+			std::string name{};
+			std::unique_ptr<Scene> pScene{};
+			//Jobs without a camera always start from the scene's own
+			Camera initialCamera{};
+			size_t memoryUsage{};
+		};
+
+		//Most recently used first
+		std::list<CachedScene> m_Scenes{};
+		size_t m_MemoryBudget{};
+		size_t m_MemoryUsage{};
+
+		std::unique_ptr<Renderer> m_pRenderer{};
+
+		uint64_t m_CacheHits{};
+		uint64_t m_CacheMisses{};
+
+		CachedScene* AcquireScene(const std::string& sceneName, bool& wasCached);
+		void EvictScenes();
+
+		bool ParseJob(const std::string& arguments, RenderJob& job, std::string& error) const;
+		std::string RunJob(const RenderJob& job);
+	};
+}
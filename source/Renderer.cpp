@@ -1,5 +1,6 @@
 //Definitions
 #define MULTITHREADING
+#define TILE_CULLING
 
 //External includes
 #include "SDL.h"
@@ -14,12 +15,56 @@
 #include "Math.h"
 #include "Matrix.h"
 #include "Material.h"
+#include "LightTree.h"
+#include "Rasterizer.h"
 #include "Scene.h"
 #include "Utils.h"
+#include "RayStats.h"
+#include "Profiler.h"
 #include  <iostream>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <numeric>
 
 using namespace dae;
 
+namespace
+{
+	//What blocked this thread's last shadow ray per light. Per thread so tiles never contend for it,
+	//per light since each light's shadows come from different places
+	thread_local std::vector<Occluder> t_LastOccluders{};
+
+	Occluder& GetLastOccluder(size_t lightIndex)
+	{
+		if (t_LastOccluders.size() <= lightIndex)
+			t_LastOccluders.resize(lightIndex + 1);
+
+		return t_LastOccluders[lightIndex];
+	}
+
+	bool IsBlack(const ColorRGB& color)
+	{
+		return color.r <= 0.f && color.g <= 0.f && color.b <= 0.f;
+	}
+
+	//Largest float below 1
+	constexpr float OneMinusEpsilon{ 0x1.fffffep-1f };
+
+	//Integer hash with good avalanche (lowbias32), cheap enough to seed every pixel
+	uint32_t Hash(uint32_t x)
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+}
+
 Renderer::Renderer(SDL_Window * pWindow) :
 	m_pWindow(pWindow),
 	m_pBuffer(SDL_GetWindowSurface(pWindow))
@@ -28,53 +73,826 @@ Renderer::Renderer(SDL_Window * pWindow) :
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
 	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
 
-	m_AspectRatio = { float(m_Width) / float(m_Height) };
+	ResetCropWindow();
+}
+
+Renderer::Renderer(int width, int height) :
+	m_pBuffer(SDL_CreateRGBSurface(0, width, height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0)),
+	m_OwnsBuffer(true)
+{
+	//Stays 0 x 0 and renders nothing, callers check IsValid
+	if (!m_pBuffer)
+	{
+		std::cout << "Could not create a " << width << "x" << height << " render buffer: " << SDL_GetError() << std::endl;
+		ResetCropWindow();
+		return;
+	}
+
+	m_Width = width;
+	m_Height = height;
+	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+
+	ResetCropWindow();
 }
 
-void Renderer::Render(Scene* pScene) const
+Renderer::~Renderer()
+{
+	if (m_OwnsBuffer)
+		SDL_FreeSurface(m_pBuffer);
+}
+
+void Renderer::Render(Scene* pScene)
+{
+	PROFILE_ZONE("Renderer::Render");
+
+	RenderRegion(pScene, Region{ 0, 0, m_Width, m_Height });
+}
+
+void Renderer::RenderRegion(Scene* pScene, const Region& region)
+{
+	m_IsIncrementalFrameValid = false;
+
+	const Region clipped{ ClipToBuffer(region) };
+	if (clipped.width <= 0 || clipped.height <= 0)
+		return;
+
+	//Tiles stay on the full frame's grid, cut down to the region at its edges
+	const int firstTileX{ clipped.x / TileSize };
+	const int firstTileY{ clipped.y / TileSize };
+	const int lastTileX{ (clipped.x + clipped.width - 1) / TileSize };
+	const int lastTileY{ (clipped.y + clipped.height - 1) / TileSize };
+
+	std::vector<Region> tiles{};
+	tiles.reserve(static_cast<size_t>(lastTileX - firstTileX + 1) * (lastTileY - firstTileY + 1));
+	for (int tileY{ firstTileY }; tileY <= lastTileY; ++tileY)
+	{
+		for (int tileX{ firstTileX }; tileX <= lastTileX; ++tileX)
+		{
+			const int startX{ std::max(tileX * TileSize, clipped.x) };
+			const int startY{ std::max(tileY * TileSize, clipped.y) };
+			const int endX{ std::min((tileX + 1) * TileSize, clipped.x + clipped.width) };
+			const int endY{ std::min((tileY + 1) * TileSize, clipped.y + clipped.height) };
+			tiles.push_back(Region{ startX, startY, endX - startX, endY - startY });
+		}
+	}
+
+	RenderTiles(pScene, tiles);
+}
+
+void Renderer::RenderIncremental(Scene* pScene)
+{
+	PROFILE_ZONE("Renderer::RenderIncremental");
+
+	const SceneChanges changes{ pScene->CollectChanges() };
+	const IncrementalState state{ GetIncrementalState(pScene) };
+
+	const bool canReuse{ m_IsIncrementalFrameValid && !changes.isEverythingDirty && m_CurrentCostMode == CostMode::None
+		&& IsSameIncrementalState(state, m_IncrementalState) };
+
+	if (!canReuse)
+	{
+		m_PixelHits.assign(static_cast<size_t>(m_Width) * m_Height, PixelHit{});
+
+		std::vector<Region> tiles(GetTileCount(m_Width, m_Height));
+		for (int tileIndex{ 0 }; tileIndex < static_cast<int>(tiles.size()); ++tileIndex)
+			tiles[tileIndex] = GetTileRegion(tileIndex, m_Width, m_Height);
+
+		RenderTiles(pScene, tiles);
+	}
+	else
+		RenderTiles(pScene, FindDirtyTiles(pScene, changes));
+
+	m_IncrementalState = state;
+	m_IsIncrementalFrameValid = true;
+}
+
+void Renderer::RenderTiles(Scene* pScene, const std::vector<Region>& tiles)
 {
 	Camera& camera = pScene->GetCamera();
 	auto& materials = pScene->GetMaterials();
 	auto& lights = pScene->GetLights();
 
-	static const float FOV{ tanf(TO_RADIANS * (camera.fovAngle / 2)) };
-	const unsigned int nrPixels{ static_cast<unsigned int>(m_Width * m_Height) };
+	//Per frame, scenes don't all share the same FOV
+	const float FOV{ tanf(TO_RADIANS * (camera.fovAngle / 2)) };
 
 	camera.CalculateCameraToWorld();
+	BeginTiles(pScene, camera, FOV);
+	RayStats::BeginFrame();
+
+	const int nrTiles{ static_cast<int>(tiles.size()) };
 #ifdef MULTITHREADING
 	//Multithreading
-	concurrency::parallel_for(0u, nrPixels,
-		[=, this](int i)
+	concurrency::combinable<uint64_t> shadowRays{};
+	concurrency::parallel_for(0, nrTiles,
+		[=, this, &tiles, &shadowRays](int tileIndex)
 		{
-			RenderPixel(pScene, camera, materials, lights, FOV, i);
+			shadowRays.local() += RenderPixels(pScene, camera, materials, lights, FOV, tiles[tileIndex]);
 		});
+	m_ShadowRayCount = shadowRays.combine(std::plus<uint64_t>());
 #else
 
-	for (int i{0}; i < nrPixels; ++i)
-		RenderPixel(pScene, camera, materials, lights, FOV, i);
+	m_ShadowRayCount = 0;
+	for (int tileIndex{0}; tileIndex < nrTiles; ++tileIndex)
+		m_ShadowRayCount += RenderPixels(pScene, camera, materials, lights, FOV, tiles[tileIndex]);
 #endif
+	m_PrimaryRayCount = 0;
+	for (const Region& tile : tiles)
+		m_PrimaryRayCount += static_cast<uint64_t>(tile.width) * tile.height;
+	RayStats::EndFrame();
+
+	if (m_CurrentCostMode != CostMode::None)
+		ApplyCostHeatmap();
 
 
 	//@END
 	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+	if (m_pWindow)
+	{
+		PROFILE_ZONE("Present");
+		SDL_UpdateWindowSurface(m_pWindow);
+	}
+}
+
+int Renderer::GetTileCount(int width, int height)
+{
+	return ((width + TileSize - 1) / TileSize) * ((height + TileSize - 1) / TileSize);
+}
+
+Renderer::Region Renderer::GetTileRegion(int tileIndex, int width, int height)
+{
+	const int nrTilesX{ (width + TileSize - 1) / TileSize };
+	const int x{ (tileIndex % nrTilesX) * TileSize };
+	const int y{ (tileIndex / nrTilesX) * TileSize };
+	return Region{ x, y, std::min(TileSize, width - x), std::min(TileSize, height - y) };
+}
+
+void Renderer::BeginTiles(Scene* pScene, const Camera& camera, float FOV)
+{
+	pScene->GetObjectBounds(m_SphereBounds, m_TriangleMeshBounds, m_MeshInstanceBounds);
+#ifdef TILE_CULLING
+	UpdateFootprints(camera, FOV);
+#endif
+
+	if (m_PrimaryVisibility == PrimaryVisibility::Rasterized)
+	{
+		if (!m_pRasterizer)
+			m_pRasterizer = std::make_unique<Rasterizer>();
+
+		const Rasterizer::Projection projection{ m_Width, m_Height, TileSize, m_ImageWidth, m_ImageHeight, m_CropX, m_CropY, m_AspectRatio, FOV };
+
+		m_pRasterizer->BeginFrame(*pScene, camera, projection);
+	}
+
+	UpdateLightRanges(pScene->GetLights());
+
+	//The bake holds Combined light with shadows, for its own scene and lights only
+	m_UseLightmap = m_pLightmap && m_pLightmapScene == pScene && m_ShadowsEnabled && m_CurrentLightMode == LightingMode::Combined
+		&& m_pLightmap->GetLightCount() == pScene->GetLights().size();
+
+	if (m_LightSampling == LightSampling::Importance)
+	{
+		if (!m_pLightTree)
+			m_pLightTree = std::make_unique<LightTree>();
+
+		m_pLightTree->Build(pScene->GetLights());
+	}
+}
+
+void Renderer::BeginFrame(Scene* pScene)
+{
+	PROFILE_ZONE("Renderer::BeginFrame");
+
+	Camera& camera = pScene->GetCamera();
+	camera.CalculateCameraToWorld();
+	BeginTiles(pScene, camera, tanf(TO_RADIANS * (camera.fovAngle / 2)));
+}
+
+unsigned int Renderer::RenderTile(Scene* pScene, int tileIndex)
+{
+	m_IsIncrementalFrameValid = false;
+
+	const Camera& camera = pScene->GetCamera();
+	const float FOV{ tanf(TO_RADIANS * (camera.fovAngle / 2)) };
+
+	return RenderPixels(pScene, camera, pScene->GetMaterials(), pScene->GetLights(), FOV, GetTileRegion(tileIndex, m_Width, m_Height));
+}
+
+void Renderer::SetCropWindow(int imageWidth, int imageHeight, int x, int y)
+{
+	m_ImageWidth = imageWidth;
+	m_ImageHeight = imageHeight;
+	m_CropX = x;
+	m_CropY = y;
+
+	m_AspectRatio = { float(m_ImageWidth) / float(m_ImageHeight) };
+}
+
+void Renderer::ResetCropWindow()
+{
+	SetCropWindow(m_Width, m_Height, 0, 0);
+}
+
+Renderer::Region Renderer::ClipToBuffer(const Region& region) const
+{
+	const int startX{ std::clamp(region.x, 0, m_Width) };
+	const int startY{ std::clamp(region.y, 0, m_Height) };
+	const int endX{ std::clamp(region.x + region.width, startX, m_Width) };
+	const int endY{ std::clamp(region.y + region.height, startY, m_Height) };
+	return Region{ startX, startY, endX - startX, endY - startY };
+}
+
+Renderer::IncrementalState Renderer::GetIncrementalState(Scene* pScene) const
+{
+	const Camera& camera{ pScene->GetCamera() };
+	return IncrementalState{ pScene, camera.origin, camera.forward, camera.fovAngle, m_ShadowsEnabled, m_CurrentLightMode, m_CurrentCostMode,
+		m_PrimaryVisibility, m_LightSampling, m_LightSamplesPerHit, m_LightCutoff, m_LightmapVersion, m_ImageWidth, m_ImageHeight, m_CropX, m_CropY };
+}
+
+bool Renderer::IsSameIncrementalState(const IncrementalState& a, const IncrementalState& b)
+{
+	const auto isSameVector = [](const Vector3& v1, const Vector3& v2)
+		{
+			return v1.x == v2.x && v1.y == v2.y && v1.z == v2.z;
+		};
+
+	return a.pScene == b.pScene && isSameVector(a.cameraOrigin, b.cameraOrigin) && isSameVector(a.cameraForward, b.cameraForward)
+		&& a.fovAngle == b.fovAngle && a.shadowsEnabled == b.shadowsEnabled && a.lightingMode == b.lightingMode && a.costMode == b.costMode
+		&& a.primaryVisibility == b.primaryVisibility && a.lightSampling == b.lightSampling && a.lightSamplesPerHit == b.lightSamplesPerHit
+		&& a.lightCutoff == b.lightCutoff && a.lightmapVersion == b.lightmapVersion
+		&& a.imageWidth == b.imageWidth && a.imageHeight == b.imageHeight && a.cropX == b.cropX && a.cropY == b.cropY;
+}
+
+std::vector<Renderer::Region> Renderer::FindDirtyTiles(Scene* pScene, const SceneChanges& changes)
+{
+	PROFILE_ZONE("Find Dirty Tiles");
+
+	const int nrTiles{ GetTileCount(m_Width, m_Height) };
+	const int nrTilesX{ (m_Width + TileSize - 1) / TileSize };
+	std::vector<uint8_t> isTileDirty(nrTiles, 0);
+
+	Camera& camera = pScene->GetCamera();
+	camera.CalculateCameraToWorld();
+	const Matrix worldToCamera{ Matrix::Inverse(camera.cameraToWorld) };
+	const float FOV{ tanf(TO_RADIANS * (camera.fovAngle / 2)) };
+
+	//Primary rays: every pixel the old or new bounds cover on screen
+	for (const Bounds& bounds : changes.dirtyBounds)
+	{
+		const Region screen{ ProjectBounds(bounds, worldToCamera, FOV) };
+		if (screen.width <= 0 || screen.height <= 0)
+			continue;
+
+		for (int tileY{ screen.y / TileSize }; tileY <= (screen.y + screen.height - 1) / TileSize; ++tileY)
+		{
+			for (int tileX{ screen.x / TileSize }; tileX <= (screen.x + screen.width - 1) / TileSize; ++tileX)
+				isTileDirty[tileY * nrTilesX + tileX] = 1;
+		}
+	}
+
+	//Shadow rays: pixels whose path to a light passes through the old or new bounds, same rays as RenderPixel
+	if (m_ShadowsEnabled)
+	{
+		const std::vector<Light>& lights{ pScene->GetLights() };
+		const auto isTileShadowDirty = [&](int tileIndex)
+			{
+				const Region tile{ GetTileRegion(tileIndex, m_Width, m_Height) };
+				for (int py{ tile.y }; py < tile.y + tile.height; ++py)
+				{
+					for (int px{ tile.x }; px < tile.x + tile.width; ++px)
+					{
+						const PixelHit& hit{ m_PixelHits[static_cast<size_t>(py) * m_Width + px] };
+						if (!hit.didHit)
+							continue;
+
+						for (const Light& light : lights)
+						{
+							Vector3 lightDir = LightUtils::GetDirectionToLight(light, hit.origin + (hit.normal * 0.001f));
+							const float lightrayMagnitude{ lightDir.Magnitude() };
+							lightDir.Normalize();
+
+							Ray lightRay{ hit.origin + (hit.normal * 0.1f), lightDir };
+							lightRay.max = lightrayMagnitude;
+
+							for (const Bounds& bounds : changes.dirtyBounds)
+							{
+								constexpr float padding{ 0.001f };
+								const Vector3 extent{ padding, padding, padding };
+								if (GeometryUtils::HitTest_SlabTest(bounds.min - extent, bounds.max + extent, lightRay))
+									return true;
+							}
+						}
+					}
+				}
+				return false;
+			};
+
+#ifdef MULTITHREADING
+		concurrency::parallel_for(0, nrTiles,
+			[&](int tileIndex)
+			{
+				if (!isTileDirty[tileIndex] && isTileShadowDirty(tileIndex))
+					isTileDirty[tileIndex] = 1;
+			});
+#else
+		for (int tileIndex{ 0 }; tileIndex < nrTiles; ++tileIndex)
+		{
+			if (!isTileDirty[tileIndex] && isTileShadowDirty(tileIndex))
+				isTileDirty[tileIndex] = 1;
+		}
+#endif
+	}
+
+	std::vector<Region> tiles{};
+	for (int tileIndex{ 0 }; tileIndex < nrTiles; ++tileIndex)
+	{
+		if (isTileDirty[tileIndex])
+			tiles.push_back(GetTileRegion(tileIndex, m_Width, m_Height));
+	}
+	return tiles;
+}
+
+Renderer::Region Renderer::ProjectBounds(const Bounds& bounds, const Matrix& worldToCamera, float FOV) const
+{
+	//Raster position of the corners, inverse of the mapping in RenderPixel
+	float minX{ FLT_MAX }, minY{ FLT_MAX };
+	float maxX{ -FLT_MAX }, maxY{ -FLT_MAX };
+	int nrCornersInFront{ 0 };
+	for (int corner{ 0 }; corner < 8; ++corner)
+	{
+		const Vector3 cameraPoint{ worldToCamera.TransformPoint(
+			(corner & 1) ? bounds.max.x : bounds.min.x,
+			(corner & 2) ? bounds.max.y : bounds.min.y,
+			(corner & 4) ? bounds.max.z : bounds.min.z) };
+
+		if (cameraPoint.z <= FLT_EPSILON)
+			continue;
+
+		++nrCornersInFront;
+		const float screenX{ cameraPoint.x / cameraPoint.z / (m_AspectRatio * FOV) };
+		const float screenY{ cameraPoint.y / cameraPoint.z / FOV };
+		const float rasterX{ (screenX + 1) * 0.5f * m_ImageWidth - 0.5f - m_CropX };
+		const float rasterY{ (1 - screenY) * 0.5f * m_ImageHeight - 0.5f - m_CropY };
+
+		minX = std::min(minX, rasterX);
+		maxX = std::max(maxX, rasterX);
+		minY = std::min(minY, rasterY);
+		maxY = std::max(maxY, rasterY);
+	}
+
+	//Entirely behind the camera, no primary ray reaches it
+	if (nrCornersInFront == 0)
+		return Region{};
+
+	//Straddles the camera plane, the projection is unbounded
+	if (nrCornersInFront < 8)
+		return Region{ 0, 0, m_Width, m_Height };
+
+	//One pixel of slack for rounding
+	const int startX{ static_cast<int>(std::floor(std::max(minX, -1.f))) - 1 };
+	const int startY{ static_cast<int>(std::floor(std::max(minY, -1.f))) - 1 };
+	const int endX{ static_cast<int>(std::ceil(std::min(maxX, static_cast<float>(m_Width)))) + 2 };
+	const int endY{ static_cast<int>(std::ceil(std::min(maxY, static_cast<float>(m_Height)))) + 2 };
+	return ClipToBuffer(Region{ startX, startY, endX - startX, endY - startY });
+}
+
+void Renderer::UpdateFootprints(const Camera& camera, float FOV)
+{
+	PROFILE_ZONE("Update Footprints");
+
+	const Matrix worldToCamera{ Matrix::Inverse(camera.cameraToWorld) };
+	const auto project = [&](const std::vector<Bounds>& bounds, std::vector<Region>& footprints)
+		{
+			footprints.resize(bounds.size());
+			for (size_t i{ 0 }; i < bounds.size(); ++i)
+				footprints[i] = ProjectBounds(bounds[i], worldToCamera, FOV);
+		};
+
+	project(m_SphereBounds, m_SphereFootprints);
+	project(m_TriangleMeshBounds, m_TriangleMeshFootprints);
+	project(m_MeshInstanceBounds, m_MeshInstanceFootprints);
+}
+
+void Renderer::GetTileObjects(Scene* pScene, const Camera& camera, float FOV, const Region& tile, ObjectList& objects) const
+{
+	const auto getOverlapping = [&tile](const std::vector<Region>& footprints, std::vector<int>& indices)
+		{
+			indices.clear();
+			for (int i{ 0 }; i < static_cast<int>(footprints.size()); ++i)
+			{
+				const Region& footprint{ footprints[i] };
+				if (footprint.x < tile.x + tile.width && tile.x < footprint.x + footprint.width
+					&& footprint.y < tile.y + tile.height && tile.y < footprint.y + footprint.height)
+					indices.push_back(i);
+			}
+		};
+
+	getOverlapping(m_SphereFootprints, objects.spheres);
+	getOverlapping(m_TriangleMeshFootprints, objects.triangleMeshes);
+	getOverlapping(m_MeshInstanceFootprints, objects.meshInstances);
+
+	//Rays through the tile's corners (a pixel outside for slack) span every ray of the tile,
+	//a plane is out of reach when all of them point away from it
+	Vector3 cornerDirections[4]{};
+	for (int corner{ 0 }; corner < 4; ++corner)
+	{
+		const float px{ static_cast<float>((corner & 1) ? tile.x + tile.width + 1 : tile.x - 1) + m_CropX };
+		const float py{ static_cast<float>((corner & 2) ? tile.y + tile.height + 1 : tile.y - 1) + m_CropY };
+		const float CamX{ (2 * (px / m_ImageWidth) - 1) * m_AspectRatio * FOV };
+		const float CamY{ (1 - 2 * (py / m_ImageHeight)) * FOV };
+		cornerDirections[corner] = camera.cameraToWorld.TransformVector(Vector3{ CamX, CamY, 1 });
+	}
+
+	const std::vector<Plane>& planes{ pScene->GetPlaneGeometries() };
+	objects.planes.clear();
+	for (int i{ 0 }; i < static_cast<int>(planes.size()); ++i)
+	{
+		//Which way the plane lies along its normal as seen from the camera
+		const float side{ Vector3::Dot(planes[i].origin - camera.origin, planes[i].normal) };
+		const bool isReachable{ std::any_of(std::begin(cornerDirections), std::end(cornerDirections),
+			[&](const Vector3& direction) { return Vector3::Dot(direction, planes[i].normal) * side >= 0.f; }) };
+
+		if (isReachable)
+			objects.planes.push_back(i);
+	}
+}
+
+unsigned int Renderer::RenderPixels(Scene* pScene, const Camera& camera, const std::vector<Material*>& materials, const std::vector<Light>& lights, const float& FOV, const Region& region)
+{
+	PROFILE_ZONE("Render Tile");
+
+#ifdef TILE_CULLING
+	ObjectList objects{};
+	GetTileObjects(pScene, camera, FOV, region, objects);
+	const ObjectList* pObjects{ &objects };
+#else
+	const ObjectList* pObjects{ nullptr };
+#endif
+
+	if (m_PrimaryVisibility == PrimaryVisibility::Rasterized)
+		m_pRasterizer->RasterizeTile(*pScene, region.x, region.y, region.width, region.height);
+
+	if (m_CurrentCostMode == CostMode::None)
+		return RenderPixelsBatched(pScene, camera, materials, lights, FOV, region, pObjects);
+
+	//The heatmap needs what every single pixel costs, so those rays stay pixel by pixel
+	unsigned int shadowRayCount{ 0 };
+	for (int py{ region.y }; py < region.y + region.height; ++py)
+	{
+		for (int px{ region.x }; px < region.x + region.width; ++px)
+			shadowRayCount += RenderPixelWithCost(pScene, camera, materials, lights, FOV, static_cast<unsigned int>(py * m_Width + px), pObjects);
+	}
+	return shadowRayCount;
+}
+
+unsigned int Renderer::RenderPixelsBatched(Scene* pScene, const Camera& camera, const std::vector<Material*>& materials, const std::vector<Light>& lights, const float& FOV, const Region& region, const ObjectList* pObjects)
+{
+	const size_t nrPixels{ static_cast<size_t>(region.width) * region.height };
+	const size_t nrLights{ lights.size() };
+	const auto getPixelIndex = [&](size_t i)
+		{
+			return static_cast<unsigned int>((region.y + i / region.width) * m_Width + region.x + i % region.width);
+		};
+
+	std::vector<HitRecord> hits(nrPixels);
+	std::vector<Ray> viewRays(nrPixels);
+	for (size_t i{ 0 }; i < nrPixels; ++i)
+		viewRays[i] = TracePrimaryRay(pScene, camera, FOV, getPixelIndex(i), pObjects, hits[i]);
+
+	std::vector<unsigned int> tileLights{};
+	GetLightsInRange(lights, hits, tileLights);
+
+	//Hits on baked planes read their light from the lightmap
+	std::vector<uint8_t> isBaked(nrPixels, 0);
+	std::vector<Lightmap::TexelLookup> lookups(m_UseLightmap ? nrPixels : 0);
+	if (m_UseLightmap)
+	{
+		for (size_t i{ 0 }; i < nrPixels; ++i)
+			isBaked[i] = hits[i].didHit && LookupLightmap(hits[i], lookups[i]);
+	}
+
+	//Lights each pixel is shaded with, pixel i's are [firstShadingLight[i], firstShadingLight[i + 1])
+	std::vector<ShadingLight> shadingLights{};
+	std::vector<size_t> firstShadingLight(nrPixels + 1);
+	for (size_t i{ 0 }; i < nrPixels; ++i)
+	{
+		firstShadingLight[i] = shadingLights.size();
+		if (hits[i].didHit)
+			GetShadingLights(hits[i], getPixelIndex(i), lights, tileLights, shadingLights);
+	}
+	firstShadingLight[nrPixels] = shadingLights.size();
+
+	//Visibility mask, one entry per shading light
+	std::vector<uint8_t> isLightVisible(shadingLights.size(), 1);
+	unsigned int shadowRayCount{ 0 };
+	if (m_ShadowsEnabled)
+	{
+		PROFILE_ZONE("Shadow Batches");
+
+		//Shading lights grouped per light, pixel order kept, so each batch goes toward a single light
+		std::vector<size_t> lightOffsets(nrLights + 1, 0);
+		for (const ShadingLight& shadingLight : shadingLights)
+			++lightOffsets[shadingLight.lightIndex + 1];
+		std::partial_sum(lightOffsets.begin(), lightOffsets.end(), lightOffsets.begin());
+
+		std::vector<size_t> lightOrder(shadingLights.size());
+		std::vector<size_t> orderPixels(shadingLights.size());
+		{
+			std::vector<size_t> nextSlot(lightOffsets.begin(), lightOffsets.end() - 1);
+			for (size_t i{ 0 }; i < nrPixels; ++i)
+			{
+				for (size_t shading{ firstShadingLight[i] }; shading < firstShadingLight[i + 1]; ++shading)
+				{
+					const size_t slot{ nextSlot[shadingLights[shading].lightIndex]++ };
+					lightOrder[slot] = shading;
+					orderPixels[slot] = i;
+				}
+			}
+		}
+
+		ObjectList shadowObjects{};
+		const auto traceBatch = [&](ShadowRayBatch& batch, const std::vector<size_t>& batchShadingLights, const ObjectList* pCandidates, Occluder& lastOccluder)
+			{
+				if (batch.rays.empty())
+					return;
+
+				GetShadowObjects(pScene, batch, shadowObjects, pCandidates);
+				batch.lastOccluder = lastOccluder;
+				pScene->DoesHit(batch, shadowObjects);
+				lastOccluder = batch.lastOccluder;
+
+				for (size_t ray{ 0 }; ray < batch.rays.size(); ++ray)
+				{
+					if (batch.isOccluded[ray])
+					{
+						RAY_STAT(ShadowHits);
+						isLightVisible[batchShadingLights[ray]] = 0;
+					}
+				}
+
+				shadowRayCount += static_cast<unsigned int>(batch.rays.size());
+			};
+
+		ShadowRayBatch batch{};
+		std::vector<size_t> batchShadingLights{};
+		//Static shadows of baked hits are in the lightmap, their rays only go up against what moves
+		ShadowRayBatch dynamicBatch{};
+		std::vector<size_t> dynamicShadingLights{};
+		for (size_t light{ 0 }; light < nrLights; ++light)
+		{
+			batch.rays.clear();
+			batchShadingLights.clear();
+			dynamicBatch.rays.clear();
+			dynamicShadingLights.clear();
+			for (size_t slot{ lightOffsets[light] }; slot < lightOffsets[light + 1]; ++slot)
+			{
+				const size_t pixel{ orderPixels[slot] };
+				const LightSample sample{ GetLightSample(hits[pixel], lights[light]) };
+				if (sample.observedArea < 0)
+					continue;
+
+				if (!isBaked[pixel])
+				{
+					batch.rays.push_back(GetShadowRay(hits[pixel], sample));
+					batchShadingLights.push_back(lightOrder[slot]);
+				}
+				else if (IsBlack(m_pLightmap->GetLight(lookups[pixel], static_cast<unsigned int>(light))))
+				{
+					isLightVisible[lightOrder[slot]] = 0;
+				}
+				else
+				{
+					dynamicBatch.rays.push_back(GetShadowRay(hits[pixel], sample));
+					dynamicShadingLights.push_back(lightOrder[slot]);
+				}
+			}
+
+			traceBatch(batch, batchShadingLights, nullptr, GetLastOccluder(light));
+
+			Occluder dynamicOccluder{};
+			traceBatch(dynamicBatch, dynamicShadingLights, &pScene->GetDynamicObjects(), dynamicOccluder);
+		}
+	}
+
+	for (size_t i{ 0 }; i < nrPixels; ++i)
+	{
+		ColorRGB finalColor{};
+		for (size_t shading{ firstShadingLight[i] }; shading < firstShadingLight[i + 1]; ++shading)
+		{
+			const Light& light{ lights[shadingLights[shading].lightIndex] };
+			const LightSample sample{ GetLightSample(hits[i], light) };
+			if (sample.observedArea < 0 || !isLightVisible[shading])
+				continue;
+
+			const ColorRGB lightColor{ isBaked[i] ? m_pLightmap->GetLight(lookups[i], shadingLights[shading].lightIndex)
+				: ShadeLight(hits[i], viewRays[i], light, materials, sample) };
+			finalColor += lightColor * shadingLights[shading].weight;
+		}
+
+		WritePixel(getPixelIndex(i), finalColor);
+	}
+
+	return shadowRayCount;
 }
 
-void Renderer::RenderPixel(Scene* pScene, const Camera& camera, const std::vector<Material*>& materials, const std::vector<Light>& lights, const float& FOV, unsigned int pixelIndex) const
+void Renderer::GetShadowObjects(Scene* pScene, const ShadowRayBatch& batch, ObjectList& objects, const ObjectList* pCandidates) const
+{
+	//The segments of the batch all lie inside the box around their end points, toward a point light that's the frustum
+	//from the tile's surface points to the light. Whatever misses the box can't block any of them
+	Bounds bounds{ batch.rays[0].origin, batch.rays[0].origin };
+	for (const Ray& ray : batch.rays)
+	{
+		for (const Vector3& point : { ray.origin + ray.direction * ray.min, ray.origin + ray.direction * ray.max })
+		{
+			bounds.min = Vector3::Min(point, bounds.min);
+			bounds.max = Vector3::Max(point, bounds.max);
+		}
+	}
+
+	constexpr float padding{ 0.001f };
+	bounds.min -= Vector3{ padding, padding, padding };
+	bounds.max += Vector3{ padding, padding, padding };
+
+	//Every object of a kind, or only the candidates' ones
+	const auto forEachIndex = [](const std::vector<int>* pIndices, size_t count, const auto& function)
+		{
+			if (pIndices)
+			{
+				for (const int i : *pIndices)
+					function(i);
+			}
+			else
+			{
+				for (int i{ 0 }; i < static_cast<int>(count); ++i)
+					function(i);
+			}
+		};
+
+	const auto getOverlapping = [&bounds, &forEachIndex](const std::vector<Bounds>& objectBounds, const std::vector<int>* pIndices, std::vector<int>& indices)
+		{
+			indices.clear();
+			forEachIndex(pIndices, objectBounds.size(), [&](int i)
+				{
+					const Bounds& other{ objectBounds[i] };
+					if (other.min.x <= bounds.max.x && bounds.min.x <= other.max.x
+						&& other.min.y <= bounds.max.y && bounds.min.y <= other.max.y
+						&& other.min.z <= bounds.max.z && bounds.min.z <= other.max.z)
+						indices.push_back(i);
+				});
+		};
+
+	getOverlapping(m_SphereBounds, pCandidates ? &pCandidates->spheres : nullptr, objects.spheres);
+	getOverlapping(m_TriangleMeshBounds, pCandidates ? &pCandidates->triangleMeshes : nullptr, objects.triangleMeshes);
+	getOverlapping(m_MeshInstanceBounds, pCandidates ? &pCandidates->meshInstances : nullptr, objects.meshInstances);
+
+	//A plane only blocks when the box reaches both of its sides
+	const std::vector<Plane>& planes{ pScene->GetPlaneGeometries() };
+	objects.planes.clear();
+	forEachIndex(pCandidates ? &pCandidates->planes : nullptr, planes.size(), [&](int i)
+	{
+		bool hasFront{ false }, hasBack{ false };
+		for (int corner{ 0 }; corner < 8; ++corner)
+		{
+			const Vector3 point{
+				(corner & 1) ? bounds.max.x : bounds.min.x,
+				(corner & 2) ? bounds.max.y : bounds.min.y,
+				(corner & 4) ? bounds.max.z : bounds.min.z };
+
+			const float distance{ Vector3::Dot(point - planes[i].origin, planes[i].normal) };
+			hasFront |= distance >= 0.f;
+			hasBack |= distance <= 0.f;
+		}
+
+		if (hasFront && hasBack)
+			objects.planes.push_back(i);
+	});
+}
+
+unsigned int Renderer::RenderPixelWithCost(Scene* pScene, const Camera& camera, const std::vector<Material*>& materials, const std::vector<Light>& lights, const float& FOV, unsigned int pixelIndex, const ObjectList* pObjects)
+{
+	switch (m_CurrentCostMode)
+	{
+	case CostMode::IntersectionTests:
+	case CostMode::SlabTests:
+	{
+		//Difference of this thread's counters around the pixel
+		const RayStats::ThreadCounters before{ RayStats::GetThreadCounters() };
+		const unsigned int shadowRayCount{ RenderPixel(pScene, camera, materials, lights, FOV, pixelIndex, pObjects) };
+		const RayStats::ThreadCounters& after{ RayStats::GetThreadCounters() };
+
+		const auto getDelta = [&](RayStats::Counter counter)
+			{
+				const int index{ static_cast<int>(counter) };
+				return static_cast<float>(after.values[index] - before.values[index]);
+			};
+
+		if (m_CurrentCostMode == CostMode::SlabTests)
+			m_CostBuffer[pixelIndex] = getDelta(RayStats::Counter::SlabTests);
+		else
+			m_CostBuffer[pixelIndex] = getDelta(RayStats::Counter::SphereTests) + getDelta(RayStats::Counter::PlaneTests) + getDelta(RayStats::Counter::TriangleTests);
+
+		return shadowRayCount;
+	}
+	case CostMode::Time:
+	{
+		const auto start{ std::chrono::steady_clock::now() };
+		const unsigned int shadowRayCount{ RenderPixel(pScene, camera, materials, lights, FOV, pixelIndex, pObjects) };
+		const auto end{ std::chrono::steady_clock::now() };
+
+		m_CostBuffer[pixelIndex] = static_cast<float>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		return shadowRayCount;
+	}
+	default:
+		return RenderPixel(pScene, camera, materials, lights, FOV, pixelIndex, pObjects);
+	}
+}
+
+void Renderer::ApplyCostHeatmap()
+{
+	PROFILE_ZONE("Cost Heatmap");
+
+	const float maxCost{ std::max(*std::max_element(m_CostBuffer.begin(), m_CostBuffer.end()), 1.f) };
+
+	//Black > blue > green > yellow > red, normalized to the most expensive pixel of the frame
+	static const ColorRGB ramp[]{ colors::Black, colors::Blue, colors::Green, colors::Yellow, colors::Red };
+	constexpr int rampSteps{ static_cast<int>(std::size(ramp)) - 1 };
+
+	for (size_t i{ 0 }; i < m_CostBuffer.size(); ++i)
+	{
+		const float scaled{ m_CostBuffer[i] / maxCost * rampSteps };
+		const int step{ std::min(static_cast<int>(scaled), rampSteps - 1) };
+		const ColorRGB color{ ColorRGB::Lerp(ramp[step], ramp[step + 1], scaled - step) };
+
+		m_pBufferPixels[i] = SDL_MapRGB(m_pBuffer->format,
+			static_cast<uint8_t>(color.r * 255),
+			static_cast<uint8_t>(color.g * 255),
+			static_cast<uint8_t>(color.b * 255));
+	}
+}
+
+unsigned int Renderer::RenderPixel(Scene* pScene, const Camera& camera, const std::vector<Material*>& materials, const std::vector<Light>& lights, const float& FOV, unsigned int pixelIndex, const ObjectList* pObjects)
+{
+	HitRecord closestHit{};
+	const Ray viewRay{ TracePrimaryRay(pScene, camera, FOV, pixelIndex, pObjects, closestHit) };
+
+	ColorRGB finalColor{};
+	unsigned int shadowRayCount{ 0 };
+
+	if (closestHit.didHit)
+	{
+		//Scratch reused across pixels
+		thread_local std::vector<ShadingLight> shadingLights{};
+		shadingLights.clear();
+		GetShadingLights(closestHit, pixelIndex, lights, m_AllLights, shadingLights);
+
+		Lightmap::TexelLookup lookup{};
+		const bool isBaked{ LookupLightmap(closestHit, lookup) };
+
+		for (const ShadingLight& shadingLight : shadingLights)
+		{
+			const Light& light{ lights[shadingLight.lightIndex] };
+			const LightSample sample{ GetLightSample(closestHit, light) };
+			if (sample.observedArea < 0)
+				continue;
+
+			//Baked light already has the static shadows in it, dark texels need no ray at all
+			const ColorRGB bakedLight{ isBaked ? m_pLightmap->GetLight(lookup, shadingLight.lightIndex) : ColorRGB{} };
+			if (isBaked && IsBlack(bakedLight))
+				continue;
+
+			if (m_ShadowsEnabled)
+			{
+				++shadowRayCount;
+				const Ray shadowRay{ GetShadowRay(closestHit, sample) };
+				if (isBaked ? IsBlockedByDynamic(pScene, shadowRay) : pScene->DoesHit(shadowRay, GetLastOccluder(shadingLight.lightIndex)))
+				{
+					RAY_STAT(ShadowHits);
+					continue;
+				}
+			}
+
+			finalColor += (isBaked ? bakedLight : ShadeLight(closestHit, viewRay, light, materials, sample)) * shadingLight.weight;
+		}
+	}
+
+	WritePixel(pixelIndex, finalColor);
+	return shadowRayCount;
+}
+
+Ray Renderer::TracePrimaryRay(Scene* pScene, const Camera& camera, const float& FOV, unsigned int pixelIndex, const ObjectList* pObjects, HitRecord& closestHit)
 {
 	const int px = pixelIndex % m_Width;
 	const int py = pixelIndex / m_Width;
 
-	//Raster to NDC
-	const float NDCx{ (px + 0.5f) / m_Width };
-	const float NDCy{ (py + 0.5f) / m_Height };
+	//Raster to NDC, on the full image when cropped
+	const float NDCx{ (px + m_CropX + 0.5f) / m_ImageWidth };
+	const float NDCy{ (py + m_CropY + 0.5f) / m_ImageHeight };
 
 	//NDC to Screen
 	const float ScreenX{ 2 * NDCx - 1 };
 	const float ScreenY{ 1 - 2 * NDCy };
 
 	//Screen To Cam
-	const float CamX{ ScreenX * (float(m_Width) / float(m_Height)) * FOV };
+	const float CamX{ ScreenX * m_AspectRatio * FOV };
 	const float CamY{ ScreenY * FOV };
 
 	Vector3 rayDirection{ CamX, CamY, 1 };
@@ -84,70 +902,361 @@ void Renderer::RenderPixel(Scene* pScene, const Camera& camera, const std::vecto
 
 	const Ray viewRay{ camera.origin, rayDirection };
 
-	ColorRGB finalColor{};
+	//Rasterized visibility leaves a single hit test, pixels it can't settle get traced
+	if (m_PrimaryVisibility != PrimaryVisibility::Rasterized || !m_pRasterizer->GetClosestHit(*pScene, pixelIndex, viewRay, closestHit))
+	{
+		if (pObjects)
+			pScene->GetClosestHit(viewRay, closestHit, *pObjects);
+		else
+			pScene->GetClosestHit(viewRay, closestHit);
+	}
 
-	HitRecord closestHit{};
+	if (closestHit.didHit)
+		RAY_STAT(PrimaryHits);
 
-	pScene->GetClosestHit(viewRay, closestHit);
+	if (!m_PixelHits.empty())
+		m_PixelHits[pixelIndex] = PixelHit{ closestHit.origin, closestHit.normal, closestHit.didHit };
 
-	if (closestHit.didHit)
+	return viewRay;
+}
+
+void Renderer::GetShadingLights(const HitRecord& hit, unsigned int pixelIndex, const std::vector<Light>& lights,
+	const std::vector<unsigned int>& candidateLights, std::vector<ShadingLight>& shadingLights) const
+{
+	//Exact when no more lights reach the hit than would be sampled. Counted per hit, the candidates depend on how the frame is split into tiles
+	const size_t firstShadingLight{ shadingLights.size() };
+	bool isExact{ true };
+	for (const unsigned int lightIndex : candidateLights)
 	{
-		for (size_t i{ 0 }; i < lights.size(); ++i)
+		if (!IsInRange(hit, lights[lightIndex], lightIndex))
+			continue;
+
+		if (m_LightSampling == LightSampling::Importance && shadingLights.size() - firstShadingLight == static_cast<size_t>(m_LightSamplesPerHit))
 		{
-			Vector3 lightDir = LightUtils::GetDirectionToLight(lights[i], closestHit.origin + (closestHit.normal * 0.001f));
-			const float lightrayMagnitude{ lightDir.Magnitude() };
-			lightDir.Normalize();
+			shadingLights.resize(firstShadingLight);
+			isExact = false;
+			break;
+		}
+		shadingLights.push_back(ShadingLight{ lightIndex, 1.f });
+	}
 
-			const float observedArea = Vector3::Dot(closestHit.normal, lightDir);
-			if (observedArea < 0)
-				continue;
+	if (isExact)
+		return;
 
-			if (m_ShadowsEnabled)
+	//Seeded by the pixel's place in the whole image, cropped and incremental frames pick the same lights as a full one
+	const uint32_t imagePixel{ static_cast<uint32_t>((pixelIndex / m_Width + m_CropY) * m_ImageWidth + pixelIndex % m_Width + m_CropX) };
+	//Same point GetLightSample measures from
+	const Vector3 origin{ hit.origin + (hit.normal * 0.001f) };
+
+	const float sampleWeight{ 1.f / m_LightSamplesPerHit };
+	for (int sample{ 0 }; sample < m_LightSamplesPerHit; ++sample)
+	{
+		//Stratified, sample s draws from [s / n, (s + 1) / n) so the picks spread over the lights' distribution
+		const float jitter{ static_cast<float>(Hash(imagePixel * m_LightSamplesPerHit + sample) >> 8) * 0x1p-24f };
+		const float u{ std::min((sample + jitter) * sampleWeight, OneMinusEpsilon) };
+
+		//Picks come from every light, one out of range counts as a zero contribution
+		LightTree::LightPick pick{};
+		if (m_pLightTree->PickLight(origin, hit.normal, u, pick) && IsInRange(hit, lights[pick.lightIndex], pick.lightIndex))
+			shadingLights.push_back(ShadingLight{ pick.lightIndex, sampleWeight / pick.probability });
+	}
+}
+
+void Renderer::UpdateLightRanges(const std::vector<Light>& lights)
+{
+	m_AllLights.resize(lights.size());
+	std::iota(m_AllLights.begin(), m_AllLights.end(), 0u);
+
+	//Radiance is intensity * color / r^2, it stays above the cutoff while r^2 < intensity * color / cutoff
+	m_LightRangesSquared.resize(lights.size());
+	for (size_t i{ 0 }; i < lights.size(); ++i)
+	{
+		const float brightest{ std::max({ lights[i].color.r, lights[i].color.g, lights[i].color.b }) };
+		m_LightRangesSquared[i] = m_LightCutoff > 0.f ? lights[i].intensity * brightest / m_LightCutoff : std::numeric_limits<float>::infinity();
+	}
+}
+
+void Renderer::GetLightsInRange(const std::vector<Light>& lights, const std::vector<HitRecord>& hits, std::vector<unsigned int>& candidateLights) const
+{
+	candidateLights.clear();
+	if (m_LightCutoff <= 0.f)
+	{
+		candidateLights = m_AllLights;
+		return;
+	}
+
+	const auto firstHit{ std::find_if(hits.begin(), hits.end(), [](const HitRecord& hit) { return hit.didHit; }) };
+	if (firstHit == hits.end())
+		return;
+
+	Bounds bounds{ firstHit->origin, firstHit->origin };
+	for (const HitRecord& hit : hits)
+	{
+		if (!hit.didHit)
+			continue;
+
+		bounds.min = Vector3::Min(hit.origin, bounds.min);
+		bounds.max = Vector3::Max(hit.origin, bounds.max);
+	}
+
+	//Padded so a light right at the edge of a hit's range never drops out for the whole tile through rounding
+	constexpr float padding{ 0.001f };
+	bounds.min -= Vector3{ padding, padding, padding };
+	bounds.max += Vector3{ padding, padding, padding };
+
+	for (unsigned int i{ 0 }; i < static_cast<unsigned int>(lights.size()); ++i)
+	{
+		const Vector3 closest{ Vector3::Max(bounds.min, Vector3::Min(lights[i].origin, bounds.max)) };
+		if ((lights[i].origin - closest).SqrMagnitude() <= m_LightRangesSquared[i])
+			candidateLights.push_back(i);
+	}
+}
+
+bool Renderer::IsInRange(const HitRecord& hit, const Light& light, unsigned int lightIndex) const
+{
+	return m_LightCutoff <= 0.f || (light.origin - hit.origin).SqrMagnitude() <= m_LightRangesSquared[lightIndex];
+}
+
+Renderer::LightSample Renderer::GetLightSample(const HitRecord& hit, const Light& light)
+{
+	LightSample sample{};
+	sample.direction = LightUtils::GetDirectionToLight(light, hit.origin + (hit.normal * 0.001f));
+	sample.distance = sample.direction.Magnitude();
+	sample.direction.Normalize();
+	sample.observedArea = Vector3::Dot(hit.normal, sample.direction);
+	return sample;
+}
+
+Ray Renderer::GetShadowRay(const HitRecord& hit, const LightSample& sample)
+{
+	Ray lightRay{ hit.origin + (hit.normal * 0.1f), sample.direction };
+	lightRay.max = sample.distance;
+	return lightRay;
+}
+
+ColorRGB Renderer::ShadeLight(const HitRecord& hit, const Ray& viewRay, const Light& light, const std::vector<Material*>& materials, const LightSample& sample) const
+{
+	switch (m_CurrentLightMode)
+	{
+	case LightingMode::ObservedArea:
+		return ColorRGB{ 1,1,1 } * sample.observedArea;
+	case LightingMode::Radiance:
+		return LightUtils::GetRadiance(light, hit.origin);
+	case LightingMode::BRDF:
+		return materials[hit.materialIndex]->Shade(hit, sample.direction, viewRay.direction);
+	case LightingMode::Combined:
+		return ShadeCombined(hit, viewRay.direction, light, materials, sample);
+	}
+	return ColorRGB{};
+}
+
+ColorRGB Renderer::ShadeCombined(const HitRecord& hit, const Vector3& viewDirection, const Light& light, const std::vector<Material*>& materials, const LightSample& sample)
+{
+	return LightUtils::GetRadiance(light, hit.origin) * sample.observedArea * materials[hit.materialIndex]->Shade(hit, sample.direction, viewDirection);
+}
+
+void Renderer::BakeLightmap(Scene* pScene, float texelSize)
+{
+	PROFILE_ZONE("Bake Lightmap");
+
+	const std::vector<Plane>& planes{ pScene->GetPlaneGeometries() };
+	const std::vector<Light>& lights{ pScene->GetLights() };
+	const std::vector<Material*> materials{ pScene->GetMaterials() };
+	const ObjectList& dynamicObjects{ pScene->GetDynamicObjects() };
+
+	pScene->GetObjectBounds(m_SphereBounds, m_TriangleMeshBounds, m_MeshInstanceBounds);
+
+	//Planes go on forever, only the part around the camera, lights and objects gets texels
+	const Vector3& cameraOrigin{ pScene->GetCamera().origin };
+	Bounds bounds{ cameraOrigin, cameraOrigin };
+	const auto addPoint = [&bounds](const Vector3& point)
+		{
+			bounds.min = Vector3::Min(point, bounds.min);
+			bounds.max = Vector3::Max(point, bounds.max);
+		};
+
+	for (const Light& light : lights)
+		addPoint(light.origin);
+	for (const Plane& plane : planes)
+		addPoint(plane.origin);
+	for (const std::vector<Bounds>* pObjectBounds : { &m_SphereBounds, &m_TriangleMeshBounds, &m_MeshInstanceBounds })
+	{
+		for (const Bounds& objectBounds : *pObjectBounds)
+		{
+			addPoint(objectBounds.min);
+			addPoint(objectBounds.max);
+		}
+	}
+
+	//Only surfaces that look the same from everywhere, for the others the light depends on where the camera is
+	std::vector<uint8_t> isBaked(planes.size());
+	for (size_t i{ 0 }; i < planes.size(); ++i)
+		isBaked[i] = materials[planes[i].materialIndex]->IsViewIndependent();
+
+	m_pLightmap = std::make_unique<Lightmap>();
+	m_pLightmap->Layout(planes, isBaked, bounds, texelSize, lights.size());
+	m_pLightmapScene = pScene;
+	++m_LightmapVersion;
+
+	//Everything the scene doesn't move casts baked shadows
+	ObjectList staticObjects{};
+	const auto getStatic = [](size_t count, const std::vector<int>& dynamic, std::vector<int>& indices)
+		{
+			for (int i{ 0 }; i < static_cast<int>(count); ++i)
 			{
-				Ray lightRay{ closestHit.origin + (closestHit.normal * 0.1f), lightDir };
-				lightRay.max = lightrayMagnitude;
-				if (pScene->DoesHit(lightRay))
-				{
-					continue;
-				}
+				if (std::find(dynamic.begin(), dynamic.end(), i) == dynamic.end())
+					indices.push_back(i);
 			}
+		};
+	getStatic(m_SphereBounds.size(), dynamicObjects.spheres, staticObjects.spheres);
+	getStatic(planes.size(), {}, staticObjects.planes);
+	getStatic(m_TriangleMeshBounds.size(), dynamicObjects.triangleMeshes, staticObjects.triangleMeshes);
+	getStatic(m_MeshInstanceBounds.size(), dynamicObjects.meshInstances, staticObjects.meshInstances);
 
-			switch (m_CurrentLightMode)
-			{
-			case LightingMode::ObservedArea:
+	//One row of texels at a time, its shadow rays toward each light go as one batch
+	struct Row
+	{
+		const Lightmap::Chart* pChart{};
+		int y{};
+	};
+	std::vector<Row> rows{};
+	for (const Lightmap::Chart& chart : m_pLightmap->GetCharts())
+	{
+		for (int y{ 0 }; y < chart.height; ++y)
+			rows.push_back(Row{ &chart, y });
+	}
+
+	const auto bakeRow = [&](const Row& row)
+		{
+			const Lightmap::Chart& chart{ *row.pChart };
+			const Plane& plane{ planes[chart.planeIndex] };
+
+			std::vector<HitRecord> hits(chart.width);
+			for (int x{ 0 }; x < chart.width; ++x)
 			{
-				finalColor += ColorRGB{ 1,1,1 } *observedArea;
+				hits[x].origin = m_pLightmap->GetTexelPosition(chart, x, row.y);
+				hits[x].normal = plane.normal;
+				hits[x].didHit = true;
+				hits[x].materialIndex = plane.materialIndex;
 			}
-			break;
-			case LightingMode::Radiance:
-				finalColor += LightUtils::GetRadiance(lights[i], closestHit.origin);
-				break;
-			case LightingMode::BRDF:
-				finalColor += materials[closestHit.materialIndex]->Shade(closestHit, lightDir, viewRay.direction);
-				break;
-			case LightingMode::Combined:
+
+			ShadowRayBatch batch{};
+			std::vector<int> batchTexels{};
+			ObjectList shadowObjects{};
+			for (size_t lightIndex{ 0 }; lightIndex < lights.size(); ++lightIndex)
 			{
-				finalColor += LightUtils::GetRadiance(lights[i], closestHit.origin) * observedArea * materials[closestHit.materialIndex]->Shade(closestHit, lightDir, viewRay.direction);
-			}
-			break;
+				const Light& light{ lights[lightIndex] };
+				batch.rays.clear();
+				batchTexels.clear();
+				for (int x{ 0 }; x < chart.width; ++x)
+				{
+					if (!m_pLightmap->IsTexelValid(chart.firstTexel + static_cast<size_t>(row.y) * chart.width + x))
+						continue;
+
+					const LightSample sample{ GetLightSample(hits[x], light) };
+					if (sample.observedArea < 0)
+						continue;
+
+					batch.rays.push_back(GetShadowRay(hits[x], sample));
+					batchTexels.push_back(x);
+				}
+
+				if (batch.rays.empty())
+					continue;
+
+				GetShadowObjects(pScene, batch, shadowObjects, &staticObjects);
+				pScene->DoesHit(batch, shadowObjects);
+
+				for (size_t ray{ 0 }; ray < batch.rays.size(); ++ray)
+				{
+					if (batch.isOccluded[ray])
+						continue;
+
+					const HitRecord& hit{ hits[batchTexels[ray]] };
+					const ColorRGB texelLight{ ShadeCombined(hit, -hit.normal, light, materials, GetLightSample(hit, light)) };
+					m_pLightmap->SetLight(chart.firstTexel + static_cast<size_t>(row.y) * chart.width + batchTexels[ray], lightIndex, texelLight);
+				}
 			}
-		}
-	}
+		};
+
+#ifdef MULTITHREADING
+	concurrency::parallel_for(size_t{ 0 }, rows.size(), [&](size_t i) { bakeRow(rows[i]); });
+#else
+	for (const Row& row : rows)
+		bakeRow(row);
+#endif
+}
 
+void Renderer::ClearLightmap()
+{
+	m_pLightmap.reset();
+	m_pLightmapScene = nullptr;
+	++m_LightmapVersion;
+}
+
+bool Renderer::LookupLightmap(const HitRecord& hit, Lightmap::TexelLookup& lookup) const
+{
+	return m_UseLightmap && hit.primitiveType == PrimitiveType::Plane && m_pLightmap->Lookup(hit.primitiveIndex, hit.origin, lookup);
+}
+
+bool Renderer::IsBlockedByDynamic(Scene* pScene, const Ray& ray) const
+{
+	//A batch of one, the batch test is the one that takes an object list
+	thread_local ShadowRayBatch batch{};
+	batch.rays.assign(1, ray);
+	batch.lastOccluder = Occluder{};
+	pScene->DoesHit(batch, pScene->GetDynamicObjects());
+	return batch.isOccluded[0] != 0;
+}
+
+void Renderer::WritePixel(unsigned int pixelIndex, ColorRGB color)
+{
 	//Update Color in Buffer
-	finalColor.MaxToOne();
+	color.MaxToOne();
 
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+	m_pBufferPixels[pixelIndex] = SDL_MapRGB(m_pBuffer->format,
+		static_cast<uint8_t>(color.r * 255),
+		static_cast<uint8_t>(color.g * 255),
+		static_cast<uint8_t>(color.b * 255));
 }
 
 bool Renderer::SaveBufferToImage() const
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+	return SaveBufferToImage("RayTracing_Buffer.bmp");
+}
+
+bool Renderer::SaveBufferToImage(const std::string& filename) const
+{
+	PROFILE_ZONE("Save Image");
+
+	return SDL_SaveBMP(m_pBuffer, filename.c_str());
+}
+
+
+std::vector<uint8_t> Renderer::GetBufferRGB() const
+{
+	std::vector<uint8_t> rgb(static_cast<size_t>(m_Width) * m_Height * 3);
+	for (size_t i{ 0 }; i < static_cast<size_t>(m_Width) * m_Height; ++i)
+		SDL_GetRGB(m_pBufferPixels[i], m_pBuffer->format, &rgb[i * 3], &rgb[i * 3 + 1], &rgb[i * 3 + 2]);
+
+	return rgb;
 }
 
+std::vector<uint8_t> Renderer::GetRegionRGB(const Region& region) const
+{
+	const Region clipped{ ClipToBuffer(region) };
+
+	std::vector<uint8_t> rgb(static_cast<size_t>(clipped.width) * clipped.height * 3);
+	for (int row{ 0 }; row < clipped.height; ++row)
+	{
+		for (int column{ 0 }; column < clipped.width; ++column)
+		{
+			const size_t i{ static_cast<size_t>(row) * clipped.width + column };
+			SDL_GetRGB(m_pBufferPixels[(clipped.y + row) * m_Width + clipped.x + column], m_pBuffer->format, &rgb[i * 3], &rgb[i * 3 + 1], &rgb[i * 3 + 2]);
+		}
+	}
+	return rgb;
+}
 
 void Renderer::ToggleLightMode()
 {
@@ -168,6 +1277,61 @@ void Renderer::ToggleLightMode()
 	}
 }
 
+void Renderer::ToggleCostMode()
+{
+	switch (m_CurrentCostMode)
+	{
+	case CostMode::None:
+#ifdef RAY_STATISTICS
+		m_CurrentCostMode = CostMode::IntersectionTests;
+		break;
+	case CostMode::IntersectionTests:
+		m_CurrentCostMode = CostMode::SlabTests;
+		break;
+	case CostMode::SlabTests:
+#endif
+		m_CurrentCostMode = CostMode::Time;
+		break;
+	default:
+		m_CurrentCostMode = CostMode::None;
+		break;
+	}
+
+	if (m_CurrentCostMode == CostMode::None)
+		m_CostBuffer.clear();
+	else
+		m_CostBuffer.assign(static_cast<size_t>(m_Width) * m_Height, 0.f);
+}
+
+bool Renderer::SaveCostBuffer(const std::string& filename) const
+{
+	PROFILE_ZONE("Save Cost Buffer");
+
+	if (m_CostBuffer.empty())
+		return false;
+
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+		return false;
+
+	//Negative scale marks little endian, rows go bottom to top
+	file << "Pf\n" << m_Width << " " << m_Height << "\n-1.0\n";
+	for (int row{ m_Height - 1 }; row >= 0; --row)
+		file.write(reinterpret_cast<const char*>(&m_CostBuffer[static_cast<size_t>(row) * m_Width]), m_Width * sizeof(float));
+
+	return static_cast<bool>(file);
+}
+
+void Renderer::TogglePrimaryVisibility()
+{
+	m_PrimaryVisibility = m_PrimaryVisibility == PrimaryVisibility::RayTraced ? PrimaryVisibility::Rasterized : PrimaryVisibility::RayTraced;
+}
+
+void Renderer::ToggleLightSampling()
+{
+	m_LightSampling = m_LightSampling == LightSampling::AllLights ? LightSampling::Importance : LightSampling::AllLights;
+}
+
 void Renderer::ToggleShadows()
 {
 	m_ShadowsEnabled = !m_ShadowsEnabled;
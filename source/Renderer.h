@@ -1,8 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "Camera.h"
+#include "Lightmap.h"
 #include "Material.h"
 
 struct SDL_Window;
@@ -11,48 +16,298 @@ struct SDL_Surface;
 namespace dae
 {
 	class Scene;
+	class Rasterizer;
+	class LightTree;
+	struct Bounds;
+	struct ObjectList;
+	struct SceneChanges;
+	struct ShadowRayBatch;
 
 	class Renderer final
 	{
 	public:
+		enum class LightingMode
+		{
+			ObservedArea, //Lambert Cosine
+			Radiance, //Incident Radiance
+			BRDF, //Scattering of light
+			Combined, //ObservedArea * Radiance * BRDF
+		};
+
+		//How the surface behind each pixel is found, shading and shadows are traced either way
+		enum class PrimaryVisibility
+		{
+			RayTraced, //One ray per pixel against the scene
+			Rasterized, //Triangles binned per tile and rasterized, only the winning primitive gets a hit test
+		};
+
+		//Which lights each hit is shaded with
+		enum class LightSampling
+		{
+			AllLights, //Every light, one shadow ray each
+			Importance, //A fixed number of lights picked from a light tree by estimated contribution, weighted by 1 / probability
+		};
+
 		Renderer(SDL_Window* pWindow);
-		~Renderer() = default;
+		//Headless, renders into an offscreen surface
+		Renderer(int width, int height);
+		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
+		//Rectangle of pixels, origin at the top left of the buffer
+		struct Region
+		{
+			int x{};
+			int y{};
+			int width{};
+			int height{};
+		};
+
+		//Pixels are handed out to the threads in square tiles, keeps neighbouring rays on the same core
+		static constexpr int TileSize{ 32 };
+		static int GetTileCount(int width, int height);
+		//Pixels covered by a tile (row major index) of a width x height image
+		static Region GetTileRegion(int tileIndex, int width, int height);
+
+		void Render(Scene* pScene);
+		//Renders only the pixels inside region (clipped to the buffer), everything else keeps the previous frame
+		void RenderRegion(Scene* pScene, const Region& region);
+		//Only re-traces the tiles that objects moved since the last call can reach, the rest is kept from the previous frame.
+		//Falls back to a full frame when the camera, lights, planes or render settings changed
+		void RenderIncremental(Scene* pScene);
+		//Per frame work RenderTile relies on (bounds, footprints, rasterized triangles, light tree).
+		//Call once after the scene or render settings changed, not per tile
+		void BeginFrame(Scene* pScene);
+		//Renders one tile (row major index) on the calling thread without presenting, returns the number of shadow rays
+		unsigned int RenderTile(Scene* pScene, int tileIndex);
+		//The buffer becomes a window at x/y onto a larger imageWidth x imageHeight image, rays are mapped as if the whole image was rendered
+		void SetCropWindow(int imageWidth, int imageHeight, int x, int y);
+		void ResetCropWindow();
 		bool SaveBufferToImage() const;
+		bool SaveBufferToImage(const std::string& filename) const;
 		void ToggleShadows();
 		void ToggleLightMode();
+		void ToggleCostMode();
+		void TogglePrimaryVisibility();
+		void ToggleLightSampling();
+		//Raw per pixel cost of the last frame as a grayscale PFM, only filled while a cost mode is active
+		bool SaveCostBuffer(const std::string& filename) const;
+		void SetShadowsEnabled(bool enabled) { m_ShadowsEnabled = enabled; }
+		void SetLightingMode(LightingMode mode) { m_CurrentLightMode = mode; }
+		void SetPrimaryVisibility(PrimaryVisibility visibility) { m_PrimaryVisibility = visibility; }
+		void SetLightSampling(LightSampling sampling) { m_LightSampling = sampling; }
+		//Lights picked per hit with LightSampling::Importance, scenes with no more lights than this shade with all of them
+		void SetLightSamplesPerHit(int samples) { m_LightSamplesPerHit = std::max(samples, 1); }
+		//Lights only reach as far as their radiance (brightest channel) stays above this, 0 lets every light reach everywhere
+		void SetLightCutoff(float radiance) { m_LightCutoff = std::max(radiance, 0.f); }
+		//Bakes the direct light on every static plane with a view independent material, shadowed by everything the scene doesn't move.
+		//Used for this scene while shadows are on in Combined mode, only moving objects still cast live shadows onto those planes.
+		//Bake again after moving lights or static objects
+		void BakeLightmap(Scene* pScene, float texelSize = 0.05f);
+		void ClearLightmap();
+		bool HasLightmap() const { return m_pLightmap != nullptr; }
+		//Last frame as tightly packed 8 bit RGB, top row first
+		std::vector<uint8_t> GetBufferRGB() const;
+		//Same for a region of it (clipped to the buffer), rows are region.width pixels long
+		std::vector<uint8_t> GetRegionRGB(const Region& region) const;
+
+		//False when the headless buffer couldn't be created
+		bool IsValid() const { return m_pBuffer != nullptr; }
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+		bool AreShadowsEnabled() const { return m_ShadowsEnabled; }
+		LightingMode GetLightingMode() const { return m_CurrentLightMode; }
+		PrimaryVisibility GetPrimaryVisibility() const { return m_PrimaryVisibility; }
+		LightSampling GetLightSampling() const { return m_LightSampling; }
+		int GetLightSamplesPerHit() const { return m_LightSamplesPerHit; }
+		float GetLightCutoff() const { return m_LightCutoff; }
+
+		//Rays traced during the last Render call
+		uint64_t GetPrimaryRayCount() const { return m_PrimaryRayCount; }
+		uint64_t GetShadowRayCount() const { return m_ShadowRayCount; }
 
 	private:
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pBuffer{};
 		uint32_t* m_pBufferPixels{};
+		bool m_OwnsBuffer{ false };
 
-		void RenderPixel(Scene* pScene, const Camera& camera, const std::vector<Material*>& materials,
-			const std::vector<Light>& lights, const float& FOV, unsigned int pixelIndex) const;
+		//Traces the tiles in parallel, then updates the ray counts, cost heatmap and window
+		void RenderTiles(Scene* pScene, const std::vector<Region>& tiles);
+		//Returns the number of shadow rays traced for these pixels
+		unsigned int RenderPixels(Scene* pScene, const Camera& camera, const std::vector<Material*>& materials,
+			const std::vector<Light>& lights, const float& FOV, const Region& region);
+		//Every primary hit of the region first, then one batch of shadow rays per light into a visibility mask, then shading
+		unsigned int RenderPixelsBatched(Scene* pScene, const Camera& camera, const std::vector<Material*>& materials,
+			const std::vector<Light>& lights, const float& FOV, const Region& region, const ObjectList* pObjects);
+		//Returns the number of shadow rays traced for this pixel, primary rays only test pObjects when it's set
+		unsigned int RenderPixel(Scene* pScene, const Camera& camera, const std::vector<Material*>& materials,
+			const std::vector<Light>& lights, const float& FOV, unsigned int pixelIndex, const ObjectList* pObjects);
+		//RenderPixel + recording its cost for the active CostMode
+		unsigned int RenderPixelWithCost(Scene* pScene, const Camera& camera, const std::vector<Material*>& materials,
+			const std::vector<Light>& lights, const float& FOV, unsigned int pixelIndex, const ObjectList* pObjects);
+		//Closest hit of the pixel's primary ray, returns the ray
+		Ray TracePrimaryRay(Scene* pScene, const Camera& camera, const float& FOV, unsigned int pixelIndex, const ObjectList* pObjects, HitRecord& closestHit);
 
-		enum class LightingMode
+		//One light as seen from a hit, shared by the shadow ray and shading
+		struct LightSample
 		{
-			ObservedArea, //Lambert Cosine
-			Radiance, //Incident Radiance
-			BRDF, //Scattering of light
-			Combined, //ObservedArea * Radiance * BRDF
+			Vector3 direction{};
+			float distance{};
+			float observedArea{};
 		};
 
+		//Light a hit is shaded with and what its contribution counts for
+		struct ShadingLight
+		{
+			unsigned int lightIndex{};
+			float weight{};
+		};
+
+		//Appends the lights the pixel's hit is shaded with, in the order their contributions are summed.
+		//Candidates are the lights that can reach it, lights out of range are left out
+		void GetShadingLights(const HitRecord& hit, unsigned int pixelIndex, const std::vector<Light>& lights,
+			const std::vector<unsigned int>& candidateLights, std::vector<ShadingLight>& shadingLights) const;
+
+		static LightSample GetLightSample(const HitRecord& hit, const Light& light);
+		static Ray GetShadowRay(const HitRecord& hit, const LightSample& sample);
+		ColorRGB ShadeLight(const HitRecord& hit, const Ray& viewRay, const Light& light, const std::vector<Material*>& materials, const LightSample& sample) const;
+		//Radiance * observed area * BRDF, LightingMode::Combined
+		static ColorRGB ShadeCombined(const HitRecord& hit, const Vector3& viewDirection, const Light& light, const std::vector<Material*>& materials, const LightSample& sample);
+		void WritePixel(unsigned int pixelIndex, ColorRGB color);
+
+		//World bounds of every object this frame
+		std::vector<Bounds> m_SphereBounds;
+		std::vector<Bounds> m_TriangleMeshBounds;
+		std::vector<Bounds> m_MeshInstanceBounds;
+
+		//Objects that can block any ray of the batch: bounds overlapping the box around all of its segments.
+		//Only the candidates' objects and planes are considered when pCandidates is set
+		void GetShadowObjects(Scene* pScene, const ShadowRayBatch& batch, ObjectList& objects, const ObjectList* pCandidates = nullptr) const;
+
+		//Pixels each object's bounds cover this frame, empty when it's behind the camera
+		std::vector<Region> m_SphereFootprints{};
+		std::vector<Region> m_TriangleMeshFootprints{};
+		std::vector<Region> m_MeshInstanceFootprints{};
+
+		void UpdateFootprints(const Camera& camera, float FOV);
+		//Objects whose footprint overlaps the tile and planes at least one of its corner rays can reach
+		void GetTileObjects(Scene* pScene, const Camera& camera, float FOV, const Region& tile, ObjectList& objects) const;
+		//Screen rectangle around the projected corners, the whole buffer when the bounds straddle the camera plane
+		Region ProjectBounds(const Bounds& bounds, const Matrix& worldToCamera, float FOV) const;
+
 		LightingMode m_CurrentLightMode{ LightingMode::Combined };
 
+		PrimaryVisibility m_PrimaryVisibility{ PrimaryVisibility::RayTraced };
+		std::unique_ptr<Rasterizer> m_pRasterizer;
+
+		LightSampling m_LightSampling{ LightSampling::AllLights };
+		int m_LightSamplesPerHit{ 4 };
+		std::unique_ptr<LightTree> m_pLightTree;
+
+		float m_LightCutoff{ 0.f };
+		//Squared distance at which each light's radiance drops to the cutoff, infinite without one
+		std::vector<float> m_LightRangesSquared{};
+		//Every light, candidates for pixels that aren't shaded per tile
+		std::vector<unsigned int> m_AllLights{};
+
+		void UpdateLightRanges(const std::vector<Light>& lights);
+
+		std::unique_ptr<Lightmap> m_pLightmap;
+		const Scene* m_pLightmapScene{};
+		//Counts bakes and clears, the incremental state changes with it
+		uint64_t m_LightmapVersion{};
+		//Whether this frame reads the lightmap, decided in BeginTiles
+		bool m_UseLightmap{ false };
+
+		//Where the hit lies on the lightmap, false when it has to be shaded live
+		bool LookupLightmap(const HitRecord& hit, Lightmap::TexelLookup& lookup) const;
+		//Shadow ray against the objects that move only, static shadows are baked
+		bool IsBlockedByDynamic(Scene* pScene, const Ray& ray) const;
+		//Lights whose range reaches the box around the hits, i.e. all a tile of them can be shaded with
+		void GetLightsInRange(const std::vector<Light>& lights, const std::vector<HitRecord>& hits, std::vector<unsigned int>& candidateLights) const;
+		bool IsInRange(const HitRecord& hit, const Light& light, unsigned int lightIndex) const;
+
+		//Per frame preparation shared by every tile: object bounds and footprints for culling, projected triangles when rasterizing,
+		//light ranges and the light tree when sampling lights
+		void BeginTiles(Scene* pScene, const Camera& camera, float FOV);
+
+		//Replaces the image with a heatmap of what each pixel's primary + shadow rays cost
+		enum class CostMode
+		{
+			None,
+			IntersectionTests, //Sphere + plane + triangle tests (needs RAY_STATISTICS)
+			SlabTests, //Bounding box visits (needs RAY_STATISTICS)
+			Time, //Nanoseconds
+		};
+
+		CostMode m_CurrentCostMode{ CostMode::None };
+		std::vector<float> m_CostBuffer{};
+
+		void ApplyCostHeatmap();
+
 		bool m_ShadowsEnabled{ false };
 
 		int m_Width{};
 		int m_Height{};
 		float m_AspectRatio{};
 
+		//Image plane the rays are mapped onto, the buffer itself unless a crop window is set
+		int m_ImageWidth{};
+		int m_ImageHeight{};
+		int m_CropX{};
+		int m_CropY{};
+
+		Region ClipToBuffer(const Region& region) const;
+
+		//Everything besides the scene's objects the previous incremental frame depends on
+		struct IncrementalState
+		{
+			const Scene* pScene{};
+			Vector3 cameraOrigin{};
+			Vector3 cameraForward{};
+			float fovAngle{};
+
+			bool shadowsEnabled{};
+			LightingMode lightingMode{};
+			CostMode costMode{};
+			PrimaryVisibility primaryVisibility{};
+			LightSampling lightSampling{};
+			int lightSamplesPerHit{};
+			float lightCutoff{};
+			uint64_t lightmapVersion{};
+
+			int imageWidth{};
+			int imageHeight{};
+			int cropX{};
+			int cropY{};
+		};
+
+		//Where each pixel's primary ray hit, filled by RenderPixel once incremental rendering is used
+		struct PixelHit
+		{
+			Vector3 origin{};
+			Vector3 normal{};
+			bool didHit{ false };
+		};
+
+		IncrementalState m_IncrementalState{};
+		std::vector<PixelHit> m_PixelHits{};
+		//Any other Render call leaves the buffer out of sync with the scene's change tracking
+		bool m_IsIncrementalFrameValid{ false };
+
+		IncrementalState GetIncrementalState(Scene* pScene) const;
+		static bool IsSameIncrementalState(const IncrementalState& a, const IncrementalState& b);
+		std::vector<Region> FindDirtyTiles(Scene* pScene, const SceneChanges& changes);
+
 		float m_Cx{}, m_Cy{};
+
+		uint64_t m_PrimaryRayCount{};
+		uint64_t m_ShadowRayCount{};
 	};
 }
@@ -1,6 +1,11 @@
 #include "Scene.h"
 #include "Utils.h"
 #include "Material.h"
+#include "RayStats.h"
+
+#include <algorithm>
+#include <ranges>
+#include <type_traits>
 
 namespace dae {
 
@@ -12,6 +17,7 @@ namespace dae {
 		m_SphereGeometries.reserve(32);
 		m_PlaneGeometries.reserve(32);
 		m_TriangleMeshGeometries.reserve(32);
+		m_TriangleMeshInstances.reserve(32);
 		m_Lights.reserve(32);
 	}
 
@@ -28,57 +34,322 @@ namespace dae {
 
 	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
 	{
-		HitRecord hit{};
-		closestHit.t = FLT_MAX;
-		for (int i = 0; i < m_SphereGeometries.size(); i++)
+		FindClosestHit(ray, closestHit, std::views::iota(0, static_cast<int>(m_SphereGeometries.size())),
+			std::views::iota(0, static_cast<int>(m_PlaneGeometries.size())),
+			std::views::iota(0, static_cast<int>(m_TriangleMeshGeometries.size())),
+			std::views::iota(0, static_cast<int>(m_TriangleMeshInstances.size())));
+	}
+
+	void Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit, const ObjectList& objects) const
+	{
+		FindClosestHit(ray, closestHit, objects.spheres, objects.planes, objects.triangleMeshes, objects.meshInstances);
+	}
+
+	template<typename SphereIndices, typename PlaneIndices, typename TriangleMeshIndices, typename MeshInstanceIndices>
+	void Scene::FindClosestHit(const Ray& ray, HitRecord& closestHit, const SphereIndices& spheres, const PlaneIndices& planes,
+		const TriangleMeshIndices& triangleMeshes, const MeshInstanceIndices& meshInstances) const
+	{
+		//Only track t + primitive while testing, max shrinks with every closer hit
+		Ray traceRay{ ray };
+		HitCandidate closest{};
+		float t{};
+
+		for (const int i : spheres)
+		{
+			if (GeometryUtils::HitTest_Sphere(m_SphereGeometries[i], traceRay, t))
+			{
+				traceRay.max = t;
+				closest.t = t;
+				closest.primitiveType = PrimitiveType::Sphere;
+				closest.primitiveIndex = i;
+			}
+		}
+
+		for (const int i : planes)
+		{
+			if (GeometryUtils::HitTest_Plane(m_PlaneGeometries[i], traceRay, t))
+			{
+				traceRay.max = t;
+				closest.t = t;
+				closest.primitiveType = PrimitiveType::Plane;
+				closest.primitiveIndex = i;
+			}
+		}
+
+		for (const int i : triangleMeshes)
+		{
+			if (GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[i], traceRay, closest))
+			{
+				traceRay.max = closest.t;
+				closest.primitiveType = PrimitiveType::TriangleMesh;
+				closest.primitiveIndex = i;
+			}
+		}
+
+		for (const int i : meshInstances)
+		{
+			if (GeometryUtils::HitTest_MeshInstance(m_TriangleMeshInstances[i], traceRay, closest))
+			{
+				traceRay.max = closest.t;
+				closest.primitiveType = PrimitiveType::TriangleMeshInstance;
+				closest.primitiveIndex = i;
+			}
+		}
+
+		//Reconstruct the surface attributes for the winner only
+		GetHitAttributes(ray, closest, closestHit);
+	}
+
+	bool Scene::GetPrimitiveHit(const Ray& ray, PrimitiveType primitiveType, unsigned int primitiveIndex, unsigned int triangleIndex, HitRecord& hit) const
+	{
+		HitCandidate candidate{};
+		bool didHit{ false };
+
+		switch (primitiveType)
 		{
-			GeometryUtils::HitTest_Sphere(m_SphereGeometries[i], ray, hit);
-			if (hit.t < closestHit.t) closestHit = hit;
+		case PrimitiveType::Sphere:
+			didHit = GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitiveIndex], ray, candidate.t);
+			break;
+		case PrimitiveType::Plane:
+			didHit = GeometryUtils::HitTest_Plane(m_PlaneGeometries[primitiveIndex], ray, candidate.t);
+			break;
+		case PrimitiveType::TriangleMesh:
+			didHit = GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[primitiveIndex], triangleIndex, ray, candidate);
+			break;
+		case PrimitiveType::TriangleMeshInstance:
+			didHit = GeometryUtils::HitTest_MeshInstance(m_TriangleMeshInstances[primitiveIndex], triangleIndex, ray, candidate);
+			break;
+		case PrimitiveType::None:
+			break;
 		}
 
-		for (int i = 0; i < m_PlaneGeometries.size(); i++)
+		if (!didHit)
+			return false;
+
+		candidate.primitiveType = primitiveType;
+		candidate.primitiveIndex = primitiveIndex;
+		GetHitAttributes(ray, candidate, hit);
+		return true;
+	}
+
+	void Scene::GetHitAttributes(const Ray& ray, const HitCandidate& candidate, HitRecord& hit) const
+	{
+		hit.t = FLT_MAX;
+		hit.didHit = false;
+
+		switch (candidate.primitiveType)
 		{
-			GeometryUtils::HitTest_Plane(m_PlaneGeometries[i], ray, hit);
-			if (hit.t < closestHit.t)	closestHit = hit;
+		case PrimitiveType::Sphere:
+			GeometryUtils::GetHitAttributes_Sphere(m_SphereGeometries[candidate.primitiveIndex], ray, candidate.t, hit);
+			break;
+		case PrimitiveType::Plane:
+			GeometryUtils::GetHitAttributes_Plane(m_PlaneGeometries[candidate.primitiveIndex], ray, candidate.t, hit);
+			break;
+		case PrimitiveType::TriangleMesh:
+			GeometryUtils::GetHitAttributes_TriangleMesh(m_TriangleMeshGeometries[candidate.primitiveIndex], ray, candidate, hit);
+			break;
+		case PrimitiveType::TriangleMeshInstance:
+			GeometryUtils::GetHitAttributes_MeshInstance(m_TriangleMeshInstances[candidate.primitiveIndex], ray, candidate, hit);
+			break;
+		case PrimitiveType::None:
+			break;
+		}
 
+		if (hit.didHit)
+		{
+			hit.primitiveType = candidate.primitiveType;
+			hit.primitiveIndex = candidate.primitiveIndex;
 		}
+	}
 
-		for (int i = 0; i < m_TriangleMeshGeometries.size(); i++)
+	//Shadow rays leave the surface, so front and back are swapped compared to view rays
+	static TriangleCullMode GetShadowCullMode(TriangleCullMode cullMode)
+	{
+		switch (cullMode)
 		{
-			GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[i], ray, hit);
-			if (hit.t < closestHit.t)	closestHit = hit;
+		case TriangleCullMode::BackFaceCulling:
+			return TriangleCullMode::FrontFaceCulling;
+		case TriangleCullMode::FrontFaceCulling:
+			return TriangleCullMode::BackFaceCulling;
+		default:
+			return cullMode;
 		}
 	}
 
 	bool Scene::DoesHit(const Ray& ray) const
 	{
-		for (const auto& sphereGeometry : m_SphereGeometries)
+		Occluder occluder{};
+		return DoesHit(ray, occluder);
+	}
+
+	bool Scene::DoesHit(const Ray& ray, Occluder& lastOccluder) const
+	{
+		if (lastOccluder.primitiveType != PrimitiveType::None)
 		{
-			if (GeometryUtils::HitTest_Sphere(sphereGeometry, ray))
+			RAY_STAT(OccluderCacheLookups);
+			if (DoesHitOccluder(ray, lastOccluder))
+			{
+				RAY_STAT(OccluderCacheHits);
 				return true;
+			}
 		}
 
-		for (const auto& m_PlaneGeometry : m_PlaneGeometries)
+		for (unsigned int i{ 0 }; i < m_SphereGeometries.size(); ++i)
 		{
-			if (GeometryUtils::HitTest_Plane(m_PlaneGeometry, ray))
+			if (GeometryUtils::HitTest_Sphere(m_SphereGeometries[i], ray))
+			{
+				lastOccluder = Occluder{ PrimitiveType::Sphere, i };
 				return true;
+			}
 		}
 
-		for (const auto& triangleGeometry : m_TriangleMeshGeometries)
+		for (unsigned int i{ 0 }; i < m_PlaneGeometries.size(); ++i)
+		{
+			if (GeometryUtils::HitTest_Plane(m_PlaneGeometries[i], ray))
+			{
+				lastOccluder = Occluder{ PrimitiveType::Plane, i };
+				return true;
+			}
+		}
+
+		unsigned int triangleIndex{};
+		for (unsigned int i{ 0 }; i < m_TriangleMeshGeometries.size(); ++i)
 		{
 			//This is in order for the shadows to work properly
-			auto modifiedTriangle = triangleGeometry;
-			if (triangleGeometry.cullMode == TriangleCullMode::BackFaceCulling)
-				modifiedTriangle.cullMode = TriangleCullMode::FrontFaceCulling;
-			if (triangleGeometry.cullMode == TriangleCullMode::FrontFaceCulling)
-				modifiedTriangle.cullMode = TriangleCullMode::BackFaceCulling;
+			const TriangleMesh& mesh{ m_TriangleMeshGeometries[i] };
+			if (GeometryUtils::HitTest_TriangleMesh(mesh, ray, GetShadowCullMode(mesh.cullMode), triangleIndex))
+			{
+				lastOccluder = Occluder{ PrimitiveType::TriangleMesh, i, triangleIndex };
+				return true;
+			}
+		}
 
-			if (GeometryUtils::HitTest_TriangleMesh(modifiedTriangle, ray))
+		for (unsigned int i{ 0 }; i < m_TriangleMeshInstances.size(); ++i)
+		{
+			const TriangleMeshInstance& instance{ m_TriangleMeshInstances[i] };
+			if (GeometryUtils::HitTest_MeshInstance(instance, ray, GetShadowCullMode(instance.cullMode), triangleIndex))
+			{
+				lastOccluder = Occluder{ PrimitiveType::TriangleMeshInstance, i, triangleIndex };
 				return true;
+			}
 		}
 		return false;
 	}
 
+	bool Scene::DoesHitOccluder(const Ray& ray, const Occluder& occluder) const
+	{
+		//Caches outlive scene switches, an index that doesn't exist anymore just misses
+		switch (occluder.primitiveType)
+		{
+		case PrimitiveType::Sphere:
+			return occluder.primitiveIndex < m_SphereGeometries.size()
+				&& GeometryUtils::HitTest_Sphere(m_SphereGeometries[occluder.primitiveIndex], ray);
+		case PrimitiveType::Plane:
+			return occluder.primitiveIndex < m_PlaneGeometries.size()
+				&& GeometryUtils::HitTest_Plane(m_PlaneGeometries[occluder.primitiveIndex], ray);
+		case PrimitiveType::TriangleMesh:
+		{
+			if (occluder.primitiveIndex >= m_TriangleMeshGeometries.size())
+				return false;
+
+			const TriangleMesh& mesh{ m_TriangleMeshGeometries[occluder.primitiveIndex] };
+			return occluder.triangleIndex < mesh.indices.size() / 3
+				&& GeometryUtils::HitTest_TriangleMesh(mesh, occluder.triangleIndex, ray, GetShadowCullMode(mesh.cullMode));
+		}
+		case PrimitiveType::TriangleMeshInstance:
+		{
+			if (occluder.primitiveIndex >= m_TriangleMeshInstances.size())
+				return false;
+
+			const TriangleMeshInstance& instance{ m_TriangleMeshInstances[occluder.primitiveIndex] };
+			return occluder.triangleIndex < instance.pMeshData->indices.size() / 3
+				&& GeometryUtils::HitTest_MeshInstance(instance, occluder.triangleIndex, ray, GetShadowCullMode(instance.cullMode));
+		}
+		default:
+			return false;
+		}
+	}
+
+	void Scene::DoesHit(ShadowRayBatch& batch, const ObjectList& objects) const
+	{
+		const size_t nrRays{ batch.rays.size() };
+		batch.isOccluded.assign(nrRays, 0);
+
+		Occluder& lastOccluder{ batch.lastOccluder };
+		unsigned int triangleIndex{};
+		for (size_t first{ 0 }; first < nrRays; first += 4)
+		{
+			//A short last packet repeats its final ray, those lanes are never active
+			Ray rays[4]{};
+			const int nrLanes{ static_cast<int>(std::min<size_t>(4, nrRays - first)) };
+			for (int lane{ 0 }; lane < 4; ++lane)
+				rays[lane] = batch.rays[first + std::min(lane, nrLanes - 1)];
+
+			const int laneMask{ (1 << nrLanes) - 1 };
+			int activeMask{ laneMask };
+			for (int lane{ 0 }; lane < nrLanes; ++lane)
+			{
+				//What blocked the previous ray first, neighbouring rays toward the same light tend to share it
+				if (lastOccluder.primitiveType != PrimitiveType::None)
+				{
+					RAY_STAT(OccluderCacheLookups);
+					if (DoesHitOccluder(rays[lane], lastOccluder))
+					{
+						RAY_STAT(OccluderCacheHits);
+						activeMask &= ~(1 << lane);
+						continue;
+					}
+				}
+
+				const auto sphere{ std::ranges::find_if(objects.spheres, [&](int i) { return GeometryUtils::HitTest_Sphere(m_SphereGeometries[i], rays[lane]); }) };
+				if (sphere != objects.spheres.end())
+				{
+					lastOccluder = Occluder{ PrimitiveType::Sphere, static_cast<unsigned int>(*sphere) };
+					activeMask &= ~(1 << lane);
+					continue;
+				}
+
+				const auto plane{ std::ranges::find_if(objects.planes, [&](int i) { return GeometryUtils::HitTest_Plane(m_PlaneGeometries[i], rays[lane]); }) };
+				if (plane != objects.planes.end())
+				{
+					lastOccluder = Occluder{ PrimitiveType::Plane, static_cast<unsigned int>(*plane) };
+					activeMask &= ~(1 << lane);
+				}
+			}
+
+			for (const int i : objects.triangleMeshes)
+			{
+				if (activeMask == 0)
+					break;
+
+				const TriangleMesh& mesh{ m_TriangleMeshGeometries[i] };
+				const int hitMask{ GeometryUtils::HitTest_TriangleMesh(mesh, rays, activeMask, GetShadowCullMode(mesh.cullMode), triangleIndex) };
+				if (hitMask != 0)
+				{
+					lastOccluder = Occluder{ PrimitiveType::TriangleMesh, static_cast<unsigned int>(i), triangleIndex };
+					activeMask &= ~hitMask;
+				}
+			}
+
+			for (const int i : objects.meshInstances)
+			{
+				if (activeMask == 0)
+					break;
+
+				const TriangleMeshInstance& instance{ m_TriangleMeshInstances[i] };
+				const int hitMask{ GeometryUtils::HitTest_MeshInstance(instance, rays, activeMask, GetShadowCullMode(instance.cullMode), triangleIndex) };
+				if (hitMask != 0)
+				{
+					lastOccluder = Occluder{ PrimitiveType::TriangleMeshInstance, static_cast<unsigned int>(i), triangleIndex };
+					activeMask &= ~hitMask;
+				}
+			}
+
+			for (int lane{ 0 }; lane < nrLanes; ++lane)
+				batch.isOccluded[first + lane] = (laneMask & ~activeMask & (1 << lane)) ? 1 : 0;
+		}
+	}
+
 #pragma region Scene Helpers
 	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
 	{
@@ -112,6 +383,200 @@ namespace dae {
 		return &m_TriangleMeshGeometries.back();
 	}
 
+	unsigned int Scene::AddTriangleMeshInstance(const std::shared_ptr<const MeshData>& pMeshData, TriangleCullMode cullMode, unsigned char materialIndex)
+	{
+		TriangleMeshInstance instance{};
+		instance.pMeshData = pMeshData;
+		instance.cullMode = cullMode;
+		instance.materialIndex = materialIndex;
+		instance.UpdateTransforms();
+
+		m_TriangleMeshInstances.emplace_back(instance);
+		return static_cast<unsigned int>(m_TriangleMeshInstances.size() - 1);
+	}
+
+	std::shared_ptr<const MeshData> Scene::LoadMeshData(const std::string& filename)
+	{
+		const auto it = m_MeshData.find(filename);
+		if (it != m_MeshData.end())
+			return it->second;
+
+		PROFILE_ZONE("Scene::LoadMeshData");
+
+		//A missing file gives an empty mesh, same as an empty TriangleMesh it just never gets hit
+		auto pMeshData = std::make_shared<MeshData>();
+		if (!Utils::LoadOBJ(filename, pMeshData->positions, pMeshData->normals, pMeshData->indices))
+			return pMeshData;
+
+		pMeshData->UpdateAABB();
+		m_MeshData[filename] = pMeshData;
+		return pMeshData;
+	}
+
+	size_t Scene::GetMemoryUsage() const
+	{
+		const auto getVectorSize = [](const auto& vector)
+			{
+				return vector.capacity() * sizeof(typename std::decay_t<decltype(vector)>::value_type);
+			};
+
+		size_t memoryUsage{ sizeof(*this) };
+		memoryUsage += getVectorSize(m_PlaneGeometries) + getVectorSize(m_SphereGeometries) + getVectorSize(m_Lights) + getVectorSize(m_Triangles);
+		memoryUsage += getVectorSize(m_TriangleMeshGeometries) + getVectorSize(m_TriangleMeshInstances);
+
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries)
+		{
+			memoryUsage += getVectorSize(mesh.positions) + getVectorSize(mesh.normals) + getVectorSize(mesh.indices);
+			memoryUsage += getVectorSize(mesh.transformedPositions) + getVectorSize(mesh.transformedNormals);
+		}
+
+		//Instances only point at these
+		for (const auto& [filename, pMeshData] : m_MeshData)
+			memoryUsage += getVectorSize(pMeshData->positions) + getVectorSize(pMeshData->normals) + getVectorSize(pMeshData->indices);
+
+		return memoryUsage;
+	}
+
+	//Raw bytes of trivially copyable members, padding never gets copied this way
+	template<typename T>
+	static void AppendState(std::vector<uint8_t>& state, const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+
+		const uint8_t* pBytes{ reinterpret_cast<const uint8_t*>(&value) };
+		state.insert(state.end(), pBytes, pBytes + sizeof(T));
+	}
+
+	static void AppendState(std::vector<uint8_t>& state, const Matrix& matrix)
+	{
+		for (int row{ 0 }; row < 4; ++row)
+			AppendState(state, matrix[row]);
+	}
+
+	static Bounds GetBounds(const Sphere& sphere)
+	{
+		const Vector3 extent{ sphere.radius, sphere.radius, sphere.radius };
+		return Bounds{ sphere.origin - extent, sphere.origin + extent };
+	}
+
+	//From the vertices, the mesh's own AABB only covers some of the corners
+	static Bounds GetBounds(const TriangleMesh& mesh)
+	{
+		if (mesh.transformedPositions.empty())
+			return Bounds{};
+
+		Bounds bounds{ mesh.transformedPositions[0], mesh.transformedPositions[0] };
+		for (const Vector3& position : mesh.transformedPositions)
+		{
+			bounds.min = Vector3::Min(position, bounds.min);
+			bounds.max = Vector3::Max(position, bounds.max);
+		}
+		return bounds;
+	}
+
+	static Bounds GetBounds(const TriangleMeshInstance& instance)
+	{
+		return Bounds{ instance.transformedMinAABB, instance.transformedMaxAABB };
+	}
+
+	void Scene::GetObjectBounds(std::vector<Bounds>& sphereBounds, std::vector<Bounds>& triangleMeshBounds, std::vector<Bounds>& meshInstanceBounds) const
+	{
+		sphereBounds.clear();
+		for (const Sphere& sphere : m_SphereGeometries)
+			sphereBounds.push_back(GetBounds(sphere));
+
+		triangleMeshBounds.clear();
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries)
+			triangleMeshBounds.push_back(GetBounds(mesh));
+
+		meshInstanceBounds.clear();
+		for (const TriangleMeshInstance& instance : m_TriangleMeshInstances)
+			meshInstanceBounds.push_back(GetBounds(instance));
+	}
+
+	SceneChanges Scene::CollectChanges()
+	{
+		PROFILE_ZONE("Scene::CollectChanges");
+
+		std::vector<uint8_t> globalState{};
+		for (const Plane& plane : m_PlaneGeometries)
+		{
+			AppendState(globalState, plane.origin);
+			AppendState(globalState, plane.normal);
+			AppendState(globalState, plane.materialIndex);
+		}
+
+		for (const Light& light : m_Lights)
+		{
+			AppendState(globalState, light.origin);
+			AppendState(globalState, light.direction);
+			AppendState(globalState, light.color);
+			AppendState(globalState, light.intensity);
+			AppendState(globalState, light.type);
+		}
+
+		AppendState(globalState, m_SphereGeometries.size());
+		AppendState(globalState, m_TriangleMeshGeometries.size());
+		AppendState(globalState, m_TriangleMeshInstances.size());
+
+		std::vector<Placement> placements{};
+		placements.reserve(m_SphereGeometries.size() + m_TriangleMeshGeometries.size() + m_TriangleMeshInstances.size());
+
+		for (const Sphere& sphere : m_SphereGeometries)
+		{
+			Placement& placement{ placements.emplace_back() };
+			AppendState(placement.state, sphere.origin);
+			AppendState(placement.state, sphere.radius);
+			AppendState(placement.state, sphere.materialIndex);
+
+			placement.bounds = GetBounds(sphere);
+		}
+
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries)
+		{
+			Placement& placement{ placements.emplace_back() };
+			AppendState(placement.state, mesh.rotationTransform);
+			AppendState(placement.state, mesh.translationTransform);
+			AppendState(placement.state, mesh.scaleTransform);
+			AppendState(placement.state, mesh.materialIndex);
+			AppendState(placement.state, mesh.cullMode);
+			AppendState(placement.state, mesh.positions.size());
+
+			placement.bounds = GetBounds(mesh);
+		}
+
+		for (const TriangleMeshInstance& instance : m_TriangleMeshInstances)
+		{
+			Placement& placement{ placements.emplace_back() };
+			AppendState(placement.state, instance.worldTransform);
+			AppendState(placement.state, instance.pMeshData.get());
+			AppendState(placement.state, instance.materialIndex);
+			AppendState(placement.state, instance.cullMode);
+
+			placement.bounds = GetBounds(instance);
+		}
+
+		SceneChanges changes{};
+		changes.isEverythingDirty = !m_HasPlacements || globalState != m_GlobalState;
+		if (!changes.isEverythingDirty)
+		{
+			//Same counts, so the placements line up
+			for (size_t i{ 0 }; i < placements.size(); ++i)
+			{
+				if (placements[i].state == m_Placements[i].state)
+					continue;
+
+				changes.dirtyBounds.push_back(m_Placements[i].bounds);
+				changes.dirtyBounds.push_back(placements[i].bounds);
+			}
+		}
+
+		m_GlobalState = std::move(globalState);
+		m_Placements = std::move(placements);
+		m_HasPlacements = true;
+		return changes;
+	}
+
 	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
 	{
 		Light l;
@@ -136,6 +601,21 @@ namespace dae {
 		return &m_Lights.back();
 	}
 
+	void Scene::SetDynamic(const Sphere* pSphere)
+	{
+		m_DynamicObjects.spheres.push_back(static_cast<int>(pSphere - m_SphereGeometries.data()));
+	}
+
+	void Scene::SetDynamic(const TriangleMesh* pMesh)
+	{
+		m_DynamicObjects.triangleMeshes.push_back(static_cast<int>(pMesh - m_TriangleMeshGeometries.data()));
+	}
+
+	void Scene::SetMeshInstanceDynamic(unsigned int index)
+	{
+		m_DynamicObjects.meshInstances.push_back(static_cast<int>(index));
+	}
+
 	unsigned char Scene::AddMaterial(Material* pMaterial)
 	{
 		m_Materials.push_back(pMaterial);
@@ -144,6 +624,22 @@ namespace dae {
 #pragma endregion
 #pragma endregion
 
+	const std::vector<SceneFactory>& GetSceneFactories()
+	{
+		static const std::vector<SceneFactory> factories
+		{
+			{ "Scene_W1", []() -> std::unique_ptr<Scene> { return std::make_unique<Scene_W1>(); } },
+			{ "Scene_W2", []() -> std::unique_ptr<Scene> { return std::make_unique<Scene_W2>(); } },
+			{ "Scene_W3_TestScene", []() -> std::unique_ptr<Scene> { return std::make_unique<Scene_W3_TestScene>(); } },
+			{ "Scene_W3", []() -> std::unique_ptr<Scene> { return std::make_unique<Scene_W3>(); } },
+			{ "Scene_W4", []() -> std::unique_ptr<Scene> { return std::make_unique<Scene_W4>(); } },
+			{ "Scene_W4_ReferenceScene", []() -> std::unique_ptr<Scene> { return std::make_unique<Scene_W4_ReferenceScene>(); } },
+			{ "Scene_W4_BunnyScene", []() -> std::unique_ptr<Scene> { return std::make_unique<Scene_W4_BunnyScene>(); } },
+		};
+
+		return factories;
+	}
+
 #pragma region SCENE W1
 	void Scene_W1::Initialize()
 	{
@@ -294,6 +790,7 @@ void dae::Scene_W4::Initialize()
 
 	//Triangle Mesh
 	pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
+	SetDynamic(pMesh);
 	Utils::ParseOBJ("Resources/simple_cube.obj", pMesh->positions, pMesh->normals, pMesh->indices);
 	pMesh->positions = {
 		{-.75f,-1.f,.0f}, // V0
@@ -390,6 +887,7 @@ void dae::Scene_W4_ReferenceScene::Initialize()
 	for (auto& mesh : m_pMeshes)
 	{
 		mesh->UpdateAABB();
+		SetDynamic(mesh);
 	}
 
 	//Light
@@ -434,13 +932,12 @@ void dae::Scene_W4_BunnyScene::Initialize()
 	AddPlane(Vector3{ -5.0f, 0.0f, 0.0f }, Vector3{ 1.0f, 0.0f, 0.0f }, matLambert_GrayBlue);; //Left
 
 
-	m_pBunny = AddTriangleMesh(dae::TriangleCullMode::BackFaceCulling, matLambert_White);
-	Utils::ParseOBJ("Resources/lowpoly_bunny2.obj", m_pBunny->positions, m_pBunny->normals, m_pBunny->indices);
-
-	m_pBunny->Scale({ 2.f,2.f,2.f });
+	m_BunnyIndex = AddTriangleMeshInstance(LoadMeshData("Resources/lowpoly_bunny2.obj"), dae::TriangleCullMode::BackFaceCulling, matLambert_White);
+	SetMeshInstanceDynamic(m_BunnyIndex);
 
-	m_pBunny->UpdateAABB();
-	m_pBunny->UpdateTransforms();
+	TriangleMeshInstance& bunny{ GetTriangleMeshInstance(m_BunnyIndex) };
+	bunny.Scale({ 2.f,2.f,2.f });
+	bunny.UpdateTransforms();
 
 	//Light
 	AddPointLight(Vector3{ 0.0f, 5.0f, 5.0f }, 50.f, ColorRGB{ 1.0f, 0.61f, 0.45f }); // Backlight
@@ -453,7 +950,8 @@ void dae::Scene_W4_BunnyScene::Update(Timer* pTimer)
 	Scene::Update(pTimer);
 
 	const float yawAngle{ (cosf(pTimer->GetTotal()) + 1.0f) / 2.0f * PI_2 };
-	m_pBunny->RotateY(yawAngle);
-	m_pBunny->UpdateTransforms();
+	TriangleMeshInstance& bunny{ GetTriangleMeshInstance(m_BunnyIndex) };
+	bunny.RotateY(yawAngle);
+	bunny.UpdateTransforms();
 }
 
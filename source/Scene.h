@@ -1,5 +1,8 @@
 #pragma once
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "Math.h"
@@ -15,6 +18,49 @@ namespace dae
 	struct Sphere;
 	struct Light;
 
+	//World space box
+	struct Bounds
+	{
+		Vector3 min{};
+		Vector3 max{};
+	};
+
+	//What moved since the previous Scene::CollectChanges call
+	struct SceneChanges
+	{
+		//Lights, planes or the set of objects changed, nothing of the previous frame can be reused
+		bool isEverythingDirty{ true };
+		//Old and new bounds of every sphere, mesh and instance that moved
+		std::vector<Bounds> dirtyBounds{};
+	};
+
+	//Indices of the objects worth testing, e.g. the ones overlapping a screen tile
+	struct ObjectList
+	{
+		std::vector<int> spheres{};
+		std::vector<int> planes{};
+		std::vector<int> triangleMeshes{};
+		std::vector<int> meshInstances{};
+	};
+
+	//Primitive that blocked a shadow ray, neighbouring rays toward the same light are usually blocked by it too
+	struct Occluder
+	{
+		PrimitiveType primitiveType{ PrimitiveType::None };
+		unsigned int primitiveIndex{};
+		unsigned int triangleIndex{};
+	};
+
+	//Shadow rays traced together, e.g. all rays of a tile toward one light
+	struct ShadowRayBatch
+	{
+		std::vector<Ray> rays{};
+		//Filled by Scene::DoesHit, 1 for every ray something blocks
+		std::vector<uint8_t> isOccluded{};
+		//Tested before anything else for every ray, DoesHit replaces it with whatever blocked the last ray it had to search for
+		Occluder lastOccluder{};
+	};
+
 	//Scene Base Class
 	class Scene
 	{
@@ -35,12 +81,30 @@ namespace dae
 
 		Camera& GetCamera() { return m_Camera; }
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
+		//Only tests the listed objects, ascending indices pick the same hit as testing everything
+		void GetClosestHit(const Ray& ray, HitRecord& closestHit, const ObjectList& objects) const;
 		bool DoesHit(const Ray& ray) const;
+		//Same, but tests lastOccluder first and replaces it when something else blocks the ray
+		bool DoesHit(const Ray& ray, Occluder& lastOccluder) const;
+		//Every ray of the batch against only the listed objects, meshes get tested 4 rays at a time
+		void DoesHit(ShadowRayBatch& batch, const ObjectList& objects) const;
+		//Hit against one known primitive (and triangle for meshes), e.g. the one a rasterizer found for the pixel
+		bool GetPrimitiveHit(const Ray& ray, PrimitiveType primitiveType, unsigned int primitiveIndex, unsigned int triangleIndex, HitRecord& hit) const;
 
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
+		const std::vector<TriangleMesh>& GetTriangleMeshGeometries() const { return m_TriangleMeshGeometries; }
+		const std::vector<TriangleMeshInstance>& GetTriangleMeshInstances() const { return m_TriangleMeshInstances; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
 		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		//Rough footprint of the geometry in bytes, used to size caches
+		size_t GetMemoryUsage() const;
+		//Compares where every object is against the previous call, the first call reports everything as dirty
+		SceneChanges CollectChanges();
+		//World bounds per sphere, triangle mesh and mesh instance, in the order they were added
+		void GetObjectBounds(std::vector<Bounds>& sphereBounds, std::vector<Bounds>& triangleMeshBounds, std::vector<Bounds>& meshInstanceBounds) const;
+		//Objects Update moves, everything else (and every plane) stays where Initialize put it
+		const ObjectList& GetDynamicObjects() const { return m_DynamicObjects; }
 
 	protected:
 		std::string	sceneName;
@@ -48,20 +112,53 @@ namespace dae
 		std::vector<Plane> m_PlaneGeometries{};
 		std::vector<Sphere> m_SphereGeometries{};
 		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
+		std::vector<TriangleMeshInstance> m_TriangleMeshInstances{};
 		std::vector<Light> m_Lights{};
 		std::vector<Material*> m_Materials{};
 
 		std::vector<Triangle> m_Triangles;
 
+		//Loaded geometry by filename, shared by every instance placed from it
+		std::unordered_map<std::string, std::shared_ptr<const MeshData>> m_MeshData{};
+
 		Camera m_Camera{};
 
 		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
 		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
 		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		//Returns an index, scenes can place more instances than fit the initial reserve and pointers would dangle once the list grows
+		unsigned int AddTriangleMeshInstance(const std::shared_ptr<const MeshData>& pMeshData, TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		TriangleMeshInstance& GetTriangleMeshInstance(unsigned int index) { return m_TriangleMeshInstances[index]; }
+		std::shared_ptr<const MeshData> LoadMeshData(const std::string& filename);
 
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
 		unsigned char AddMaterial(Material* pMaterial);
+
+		//Scenes mark every object their Update moves, lighting of static ones can be baked
+		ObjectList m_DynamicObjects{};
+		void SetDynamic(const Sphere* pSphere);
+		void SetDynamic(const TriangleMesh* pMesh);
+		void SetMeshInstanceDynamic(unsigned int index);
+
+	private:
+		template<typename SphereIndices, typename PlaneIndices, typename TriangleMeshIndices, typename MeshInstanceIndices>
+		void FindClosestHit(const Ray& ray, HitRecord& closestHit, const SphereIndices& spheres, const PlaneIndices& planes,
+			const TriangleMeshIndices& triangleMeshes, const MeshInstanceIndices& meshInstances) const;
+		void GetHitAttributes(const Ray& ray, const HitCandidate& candidate, HitRecord& hit) const;
+		bool DoesHitOccluder(const Ray& ray, const Occluder& occluder) const;
+
+		//Everything that decides where an object is, compared byte for byte
+		struct Placement
+		{
+			std::vector<uint8_t> state{};
+			Bounds bounds{};
+		};
+
+		//Previous CollectChanges call, lights and planes go in the global state since they reach every pixel
+		std::vector<uint8_t> m_GlobalState{};
+		std::vector<Placement> m_Placements{};
+		bool m_HasPlacements{ false };
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -169,6 +266,15 @@ namespace dae
 		void Initialize() override;
 		void Update(Timer* pTimer) override;
 	private:
-		TriangleMesh* m_pBunny{ nullptr };
+		unsigned int m_BunnyIndex{};
+	};
+
+	//Every built-in scene by name, used by the headless modes
+	struct SceneFactory
+	{
+		const char* name;
+		std::unique_ptr<Scene>(*create)();
 	};
+
+	const std::vector<SceneFactory>& GetSceneFactories();
 }
@@ -0,0 +1,216 @@
+#include "Socket.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+using namespace dae;
+
+namespace
+{
+#ifdef _WIN32
+	using NativeSocket = SOCKET;
+
+	//Winsock has to be started once per process
+	void InitializeSockets()
+	{
+		static const bool isInitialized = []
+			{
+				WSADATA data{};
+				return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+			}();
+		(void)isInitialized;
+	}
+
+	void CloseNative(NativeSocket handle)
+	{
+		closesocket(handle);
+	}
+#else
+	using NativeSocket = int;
+
+	void InitializeSockets()
+	{
+	}
+
+	void CloseNative(NativeSocket handle)
+	{
+		close(handle);
+	}
+#endif
+
+	//A worker that died shouldn't take the coordinator down with SIGPIPE
+#ifdef MSG_NOSIGNAL
+	constexpr int SendFlags{ MSG_NOSIGNAL };
+#else
+	constexpr int SendFlags{ 0 };
+#endif
+
+	NativeSocket ToNative(uintptr_t handle)
+	{
+		return static_cast<NativeSocket>(handle);
+	}
+
+	//Tiles are small messages, don't wait to batch them
+	void DisableNagle(NativeSocket handle)
+	{
+		int enable{ 1 };
+		setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable), sizeof(enable));
+	}
+}
+
+TcpSocket::~TcpSocket()
+{
+	Close();
+}
+
+bool TcpSocket::Listen(uint16_t port)
+{
+	InitializeSockets();
+	Close();
+
+	const NativeSocket handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (static_cast<uintptr_t>(handle) == InvalidHandle)
+		return false;
+	m_Handle = static_cast<uintptr_t>(handle);
+
+	//Restarting the coordinator right away shouldn't fail on a socket in TIME_WAIT
+	int enable{ 1 };
+	setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&enable), sizeof(enable));
+
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+
+	if (bind(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(handle, SOMAXCONN) != 0)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool TcpSocket::Accept(TcpSocket& client) const
+{
+	client.Close();
+
+	const NativeSocket handle = accept(ToNative(m_Handle), nullptr, nullptr);
+	if (static_cast<uintptr_t>(handle) == InvalidHandle)
+		return false;
+
+	DisableNagle(handle);
+	client.m_Handle = static_cast<uintptr_t>(handle);
+	return true;
+}
+
+bool TcpSocket::Connect(const std::string& host, uint16_t port)
+{
+	InitializeSockets();
+	Close();
+
+	addrinfo hints{};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	addrinfo* pResults{ nullptr };
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &pResults) != 0)
+		return false;
+
+	for (const addrinfo* pAddress{ pResults }; pAddress; pAddress = pAddress->ai_next)
+	{
+		const NativeSocket handle = socket(pAddress->ai_family, pAddress->ai_socktype, pAddress->ai_protocol);
+		if (static_cast<uintptr_t>(handle) == InvalidHandle)
+			continue;
+
+		if (connect(handle, pAddress->ai_addr, static_cast<int>(pAddress->ai_addrlen)) == 0)
+		{
+			DisableNagle(handle);
+			m_Handle = static_cast<uintptr_t>(handle);
+			break;
+		}
+		CloseNative(handle);
+	}
+
+	freeaddrinfo(pResults);
+	return IsValid();
+}
+
+void TcpSocket::SetReceiveTimeout(float seconds) const
+{
+#ifdef _WIN32
+	const DWORD timeout{ static_cast<DWORD>(seconds * 1000.f) };
+#else
+	timeval timeout{};
+	timeout.tv_sec = static_cast<time_t>(seconds);
+	timeout.tv_usec = static_cast<suseconds_t>((seconds - static_cast<float>(timeout.tv_sec)) * 1e6f);
+#endif
+	setsockopt(ToNative(m_Handle), SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+}
+
+void TcpSocket::Shutdown() const
+{
+	if (!IsValid())
+		return;
+
+#ifdef _WIN32
+	shutdown(ToNative(m_Handle), SD_BOTH);
+#else
+	shutdown(ToNative(m_Handle), SHUT_RDWR);
+#endif
+}
+
+void TcpSocket::Close()
+{
+	if (!IsValid())
+		return;
+
+	CloseNative(ToNative(m_Handle));
+	m_Handle = InvalidHandle;
+}
+
+bool TcpSocket::SendAll(const void* pData, size_t size) const
+{
+	const char* pBytes{ static_cast<const char*>(pData) };
+	while (size > 0)
+	{
+		const int chunk{ static_cast<int>(std::min<size_t>(size, 1 << 20)) };
+		const auto sent = send(ToNative(m_Handle), pBytes, chunk, SendFlags);
+		if (sent <= 0)
+			return false;
+
+		pBytes += sent;
+		size -= static_cast<size_t>(sent);
+	}
+	return true;
+}
+
+bool TcpSocket::ReceiveAll(void* pData, size_t size) const
+{
+	char* pBytes{ static_cast<char*>(pData) };
+	while (size > 0)
+	{
+		const int chunk{ static_cast<int>(std::min<size_t>(size, 1 << 20)) };
+		const auto received = recv(ToNative(m_Handle), pBytes, chunk, 0);
+		if (received <= 0)
+			return false;
+
+		pBytes += received;
+		size -= static_cast<size_t>(received);
+	}
+	return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	//Blocking TCP connection or listener, closed when destroyed
+	class TcpSocket final
+	{
+	public:
+		TcpSocket() = default;
+		~TcpSocket();
+
+		TcpSocket(const TcpSocket&) = delete;
+		TcpSocket(TcpSocket&&) noexcept = delete;
+		TcpSocket& operator=(const TcpSocket&) = delete;
+		TcpSocket& operator=(TcpSocket&&) noexcept = delete;
+
+		bool Listen(uint16_t port);
+		bool Accept(TcpSocket& client) const;
+		bool Connect(const std::string& host, uint16_t port);
+		//Receives fail after this long without data, 0 waits forever
+		void SetReceiveTimeout(float seconds) const;
+		//Wakes up a Send/Receive blocked on another thread, the socket stays open until Close
+		void Shutdown() const;
+		void Close();
+
+		bool IsValid() const { return m_Handle != InvalidHandle; }
+
+		//Loop until everything went through, false once the connection is gone
+		bool SendAll(const void* pData, size_t size) const;
+		bool ReceiveAll(void* pData, size_t size) const;
+
+	private:
+		//SOCKET on Windows, a file descriptor everywhere else
+		static constexpr uintptr_t InvalidHandle{ ~uintptr_t{ 0 } };
+		uintptr_t m_Handle{ InvalidHandle };
+	};
+}
@@ -1,5 +1,7 @@
 #include "Timer.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <numeric>
 
@@ -24,6 +26,9 @@ void Timer::Reset()
 	m_StopTime = 0;
 	m_FPSTimer = 0.0f;
 	m_FPSCount = 0;
+	m_SimulatedTime = 0.0f;
+	m_WallTime = 0.0f;
+	m_WallTimeOffset = 0.0f;
 	m_IsStopped = false;
 }
 
@@ -60,6 +65,7 @@ void Timer::StartBenchmark(int numFrames)
 
 	m_Benchmarks.clear();
 	m_Benchmarks.resize(m_BenchmarkFrames);
+	m_BenchmarkFrameTimes.Reset();
 
 	std::cout<< "**BENCHMARK STARTED**\n";
 }
@@ -83,15 +89,29 @@ void Timer::Update()
 	if (m_ElapsedTime < 0.0f)
 		m_ElapsedTime = 0.0f;
 
+	//Before the upper bound, that's what hitches look like
+	m_CurrentSecondFrameTimes.AddFrame(m_ElapsedTime * 1000.f);
+	if (m_BenchmarkActive)
+		m_BenchmarkFrameTimes.AddFrame(m_ElapsedTime * 1000.f);
+
 	if (m_ForceElapsedUpperBound && m_ElapsedTime > m_ElapsedUpperBound)
 	{
 		m_ElapsedTime = m_ElapsedUpperBound;
 	}
 
-	m_TotalTime = (float)(((m_CurrentTime - m_PausedTime) - m_BaseTime) * m_SecondsPerCount);
+	m_WallTime = (float)(((m_CurrentTime - m_PausedTime) - m_BaseTime) * m_SecondsPerCount);
+	m_TotalTime = m_WallTime + m_WallTimeOffset;
+	m_RealElapsedTime = m_ElapsedTime;
+
+	if (m_FixedTimeStep > 0.f)
+	{
+		m_SimulatedTime += m_FixedTimeStep;
+		m_ElapsedTime = m_FixedTimeStep;
+		m_TotalTime = m_SimulatedTime;
+	}
 
 	//FPS LOGIC
-	m_FPSTimer += m_ElapsedTime;
+	m_FPSTimer += m_RealElapsedTime;
 	++m_FPSCount;
 	if (m_FPSTimer >= 1.0f)
 	{
@@ -100,6 +120,9 @@ void Timer::Update()
 		m_FPSCount = 0;
 		m_FPSTimer = 0.0f;
 
+		m_LastSecondFrameTimes = m_CurrentSecondFrameTimes;
+		m_CurrentSecondFrameTimes.Reset();
+
 		if (m_BenchmarkActive)
 		{
 			m_Benchmarks[m_BenchmarkCurrFrame] = m_dFPS;
@@ -118,14 +141,14 @@ void Timer::Update()
 				std::cout << ">> HIGH = " << m_BenchmarkHigh << std::endl;
 				std::cout << ">> LOW = " << m_BenchmarkLow << std::endl;
 				std::cout << ">> AVG = " << m_BenchmarkAvg << std::endl;
+				std::cout << ">> FRAME TIME p50/p90/p99/max = " << m_BenchmarkFrameTimes.GetPercentile(50.f) << " / "
+					<< m_BenchmarkFrameTimes.GetPercentile(90.f) << " / " << m_BenchmarkFrameTimes.GetPercentile(99.f) << " / "
+					<< m_BenchmarkFrameTimes.GetMax() << " ms" << std::endl;
+				std::cout << ">> STDDEV = " << m_BenchmarkFrameTimes.GetStandardDeviation() << " ms" << std::endl;
+				std::cout << ">> STUTTERS = " << m_BenchmarkFrameTimes.GetStutterCount() << " of " << m_BenchmarkFrameTimes.GetFrameCount() << " frames" << std::endl;
 
 				//file save
-				std::ofstream fileStream("benchmark.txt");
-				fileStream << "FRAMES = " << m_BenchmarkCurrFrame << std::endl;
-				fileStream << "HIGH = " << m_BenchmarkHigh << std::endl;
-				fileStream << "LOW = " << m_BenchmarkLow << std::endl;
-				fileStream << "AVG = " << m_BenchmarkAvg << std::endl;
-				fileStream.close();
+				WriteBenchmarkResults();
 			}
 		}
 	}
@@ -141,3 +164,132 @@ void Timer::Stop()
 		m_IsStopped = true;
 	}
 }
+
+void Timer::SetFixedTimeStep(float timeStep)
+{
+	//Picks up from the current scene time instead of restarting the animations
+	if (timeStep > 0.f && m_FixedTimeStep <= 0.f)
+		m_SimulatedTime = m_TotalTime;
+
+	//Same the other way, wall clock time continues from where the fixed steps got to
+	if (timeStep <= 0.f && m_FixedTimeStep > 0.f)
+		m_WallTimeOffset = m_SimulatedTime - m_WallTime;
+
+	m_FixedTimeStep = std::max(timeStep, 0.f);
+}
+
+void Timer::WriteBenchmarkResults() const
+{
+	std::ofstream fileStream("benchmark_interactive.json");
+	fileStream << "{\n";
+	fileStream << "  \"samples\": " << m_BenchmarkCurrFrame << ",\n";
+	//0 when the scenes ran on wall clock time
+	fileStream << "  \"fixedTimeStep\": " << m_FixedTimeStep << ",\n";
+	fileStream << "  \"fps\": { \"high\": " << m_BenchmarkHigh << ", \"low\": " << m_BenchmarkLow << ", \"avg\": " << m_BenchmarkAvg << " },\n";
+	fileStream << "  \"frameTimeMs\": {\n";
+	fileStream << "    \"frames\": " << m_BenchmarkFrameTimes.GetFrameCount() << ",\n";
+	fileStream << "    \"p50\": " << m_BenchmarkFrameTimes.GetPercentile(50.f) << ",\n";
+	fileStream << "    \"p90\": " << m_BenchmarkFrameTimes.GetPercentile(90.f) << ",\n";
+	fileStream << "    \"p99\": " << m_BenchmarkFrameTimes.GetPercentile(99.f) << ",\n";
+	fileStream << "    \"max\": " << m_BenchmarkFrameTimes.GetMax() << ",\n";
+	fileStream << "    \"mean\": " << m_BenchmarkFrameTimes.GetMean() << ",\n";
+	fileStream << "    \"stddev\": " << m_BenchmarkFrameTimes.GetStandardDeviation() << "\n";
+	fileStream << "  },\n";
+	//Frames longer than twice the median
+	fileStream << "  \"stutters\": " << m_BenchmarkFrameTimes.GetStutterCount() << "\n";
+	fileStream << "}\n";
+}
+
+void Timer::SetSimulatedTime(float totalTime, float elapsedTime)
+{
+	m_TotalTime = totalTime;
+	m_ElapsedTime = elapsedTime;
+}
+
+void FrameTimeHistogram::Reset()
+{
+	m_Buckets.fill(0);
+	m_FrameCount = 0;
+	m_SumMs = 0.0;
+	m_SumSquaredMs = 0.0;
+	m_MaxMs = 0.f;
+}
+
+namespace
+{
+	//Ratio between the end and start of every bucket but the first
+	const double g_LogBucketGrowth{ std::log(static_cast<double>(FrameTimeHistogram::MaxMs) / FrameTimeHistogram::MinMs) / (FrameTimeHistogram::BucketCount - 1) };
+}
+
+float FrameTimeHistogram::GetBucketStart(int bucket)
+{
+	return bucket <= 0 ? 0.f : static_cast<float>(MinMs * std::exp((bucket - 1) * g_LogBucketGrowth));
+}
+
+float FrameTimeHistogram::GetBucketEnd(int bucket)
+{
+	return static_cast<float>(MinMs * std::exp(bucket * g_LogBucketGrowth));
+}
+
+int FrameTimeHistogram::GetBucket(float frameTimeMs)
+{
+	if (!(frameTimeMs >= MinMs))
+		return 0;
+
+	const int bucket{ 1 + static_cast<int>(std::log(static_cast<double>(frameTimeMs) / MinMs) / g_LogBucketGrowth) };
+	return std::min(bucket, BucketCount - 1);
+}
+
+void FrameTimeHistogram::AddFrame(float frameTimeMs)
+{
+	++m_Buckets[GetBucket(frameTimeMs)];
+
+	++m_FrameCount;
+	m_SumMs += frameTimeMs;
+	m_SumSquaredMs += static_cast<double>(frameTimeMs) * frameTimeMs;
+	m_MaxMs = std::max(m_MaxMs, frameTimeMs);
+}
+
+float FrameTimeHistogram::GetMean() const
+{
+	return m_FrameCount > 0 ? static_cast<float>(m_SumMs / m_FrameCount) : 0.f;
+}
+
+float FrameTimeHistogram::GetStandardDeviation() const
+{
+	if (m_FrameCount == 0)
+		return 0.f;
+
+	const double mean{ m_SumMs / m_FrameCount };
+	return static_cast<float>(std::sqrt(std::max(m_SumSquaredMs / m_FrameCount - mean * mean, 0.0)));
+}
+
+float FrameTimeHistogram::GetPercentile(float percentile) const
+{
+	if (m_FrameCount == 0)
+		return 0.f;
+
+	const uint32_t rank{ std::max(static_cast<uint32_t>(std::ceil(percentile / 100.f * m_FrameCount)), 1u) };
+
+	uint32_t count{};
+	for (int i{ 0 }; i < BucketCount; ++i)
+	{
+		count += m_Buckets[i];
+		if (count >= rank)
+			return std::min(GetBucketEnd(i), m_MaxMs);
+	}
+	return m_MaxMs;
+}
+
+uint32_t FrameTimeHistogram::GetStutterCount(float factor) const
+{
+	const float threshold{ factor * GetPercentile(50.f) };
+
+	uint32_t count{};
+	for (int i{ 0 }; i < BucketCount; ++i)
+	{
+		if (GetBucketStart(i) >= threshold)
+			count += m_Buckets[i];
+	}
+	return count;
+}
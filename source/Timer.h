@@ -1,11 +1,48 @@
 #pragma once
 
 //Standard includes
+#include <array>
 #include <cstdint>
 #include <vector>
 
 namespace dae
 {
+	//Fixed size, recording a frame never allocates
+	class FrameTimeHistogram final
+	{
+	public:
+		//Bucket 0 holds everything below MinMs, the others grow by the same factor each up to MaxMs,
+		//about 1.4% wide whether frames take a millisecond or seconds. Longer frames end up in the last bucket
+		static constexpr int BucketCount{ 1000 };
+		static constexpr float MinMs{ 0.1f };
+		static constexpr float MaxMs{ 100'000.f };
+
+		//Frames in bucket i took [GetBucketStart(i), GetBucketEnd(i)) ms
+		static float GetBucketStart(int bucket);
+		static float GetBucketEnd(int bucket);
+
+		void Reset();
+		void AddFrame(float frameTimeMs);
+
+		uint32_t GetFrameCount() const { return m_FrameCount; }
+		float GetMax() const { return m_MaxMs; }
+		float GetMean() const;
+		float GetStandardDeviation() const;
+		//Nearest rank, accurate to one bucket
+		float GetPercentile(float percentile) const;
+		//Frames that took longer than factor * p50, counted from the first bucket starting at or above it
+		uint32_t GetStutterCount(float factor = 2.f) const;
+
+	private:
+		static int GetBucket(float frameTimeMs);
+
+		std::array<uint32_t, BucketCount> m_Buckets{};
+		uint32_t m_FrameCount{};
+		double m_SumMs{};
+		double m_SumSquaredMs{};
+		float m_MaxMs{};
+	};
+
 	class Timer
 	{
 	public:
@@ -24,11 +61,21 @@ namespace dae
 		void Update();
 		void Stop();
 
+		//Overrides the clock for headless runs, only valid until the next Update
+		void SetSimulatedTime(float totalTime, float elapsedTime);
+		//Scene time advances by timeStep every Update no matter how long the frame took, 0 goes back to wall clock time
+		void SetFixedTimeStep(float timeStep);
+		bool IsFixedTimeStep() const { return m_FixedTimeStep > 0.f; };
+
 		uint32_t GetFPS() const { return m_FPS; };
 		float GetdFPS() const { return m_dFPS; };
 		float GetElapsed() const { return m_ElapsedTime; };
 		float GetTotal() const { return m_TotalTime; };
+		//Wall clock duration of the last frame, even with a fixed time step
+		float GetRealElapsed() const { return m_RealElapsedTime; };
 		bool IsRunning() const { return !m_IsStopped; };
+		//Every frame of the last full second
+		const FrameTimeHistogram& GetFrameTimes() const { return m_LastSecondFrameTimes; };
 
 	private:
 		uint64_t m_BaseTime = 0;
@@ -43,6 +90,12 @@ namespace dae
 
 		float m_TotalTime = 0.0f;
 		float m_ElapsedTime = 0.0f;
+		float m_RealElapsedTime = 0.0f;
+		float m_FixedTimeStep = 0.0f;
+		float m_SimulatedTime = 0.0f;
+		//Wall clock time of the last Update, and what gets added to it so leaving a fixed time step carries on from the simulated time
+		float m_WallTime = 0.0f;
+		float m_WallTimeOffset = 0.0f;
 		float m_SecondsPerCount = 0.0f;
 		float m_ElapsedUpperBound = 0.03f;
 		float m_FPSTimer = 0.0f;
@@ -57,5 +110,11 @@ namespace dae
 		int m_BenchmarkFrames{ 0 };
 		int m_BenchmarkCurrFrame{ 0 };
 		std::vector<float> m_Benchmarks{};
+
+		FrameTimeHistogram m_CurrentSecondFrameTimes{};
+		FrameTimeHistogram m_LastSecondFrameTimes{};
+		FrameTimeHistogram m_BenchmarkFrameTimes{};
+
+		void WriteBenchmarkResults() const;
 	};
 }
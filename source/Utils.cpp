@@ -1,13 +1,26 @@
 #include "Utils.h"
 #include <cassert>
+#include <charconv>
 #include <fstream>
+#include <thread>
+#include <xmmintrin.h>
+
+//Multithreading
+#include <ppl.h>
+
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "RayStats.h"
+#include "Profiler.h"
 
 namespace dae
 {
     namespace GeometryUtils
     {
-        bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord)
+        bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, float& t)
         {
+            RAY_STAT(SphereTests);
+
             Vector3 L{ sphere.origin - ray.origin };
             Vector3 d{ ray.direction.Normalized() };
             float Tca{ Vector3::Dot(L, d) };
@@ -19,57 +32,69 @@ namespace dae
             float Thc = SquareRootImp(Square(sphere.radius) - od2);
             float t0 = Tca - Thc;
             float t1 = Tca + Thc;
-            float t{ t1 };
+            float tHit{ t1 };
             if ((t0 < t1) && (t0 > 0))
             {
-                t = t0;
+                tHit = t0;
             }
 
-            if (t > ray.min && t < ray.max)
+            if (tHit > ray.min && tHit < ray.max)
             {
-                Vector3 p{ ray.origin + t * d };
-
-                hitRecord.didHit = true;
-                hitRecord.origin = p;
-                hitRecord.t = t;
-
-                hitRecord.normal = p - sphere.origin;
-                hitRecord.normal.Normalize();
-
-                hitRecord.materialIndex = sphere.materialIndex;
+                t = tHit;
+                return true;
             }
 
-            return hitRecord.didHit;
+            return false;
         }
 
         bool HitTest_Sphere(const Sphere& sphere, const Ray& ray)
         {
-            HitRecord temp{};
-            return HitTest_Sphere(sphere, ray, temp, true);
+            float t{};
+            return HitTest_Sphere(sphere, ray, t);
         }
 
-        bool HitTest_Plane(const Plane& plane, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord)
+        void GetHitAttributes_Sphere(const Sphere& sphere, const Ray& ray, float t, HitRecord& hitRecord)
         {
-            float t = (Vector3::Dot((plane.origin - ray.origin), plane.normal.Normalized() / Vector3::Dot(ray.direction, plane.normal)));
+            const Vector3 p{ ray.origin + t * ray.direction.Normalized() };
 
-            if (t >= ray.min && t <= ray.max)
-            {
-                Vector3 interPoint{ ray.origin.x + ray.direction.x * t, ray.origin.y + ray.direction.y * t, ray.origin.z + ray.direction.z * t };
+            hitRecord.didHit = true;
+            hitRecord.origin = p;
+            hitRecord.t = t;
+
+            hitRecord.normal = p - sphere.origin;
+            hitRecord.normal.Normalize();
+
+            hitRecord.materialIndex = sphere.materialIndex;
+        }
+
+        bool HitTest_Plane(const Plane& plane, const Ray& ray, float& t)
+        {
+            RAY_STAT(PlaneTests);
+
+            const float tHit = (Vector3::Dot((plane.origin - ray.origin), plane.normal.Normalized() / Vector3::Dot(ray.direction, plane.normal)));
 
-                hitRecord.didHit = true;
-                hitRecord.origin = interPoint;
-                hitRecord.materialIndex = plane.materialIndex;
-                hitRecord.normal = plane.normal.Normalized();
-                hitRecord.t = t;
+            if (tHit >= ray.min && tHit < ray.max)
+            {
+                t = tHit;
+                return true;
             }
 
-            return hitRecord.didHit;
+            return false;
         }
 
         bool HitTest_Plane(const Plane& plane, const Ray& ray)
         {
-            HitRecord temp{};
-            return HitTest_Plane(plane, ray, temp, true);
+            float t{};
+            return HitTest_Plane(plane, ray, t);
+        }
+
+        void GetHitAttributes_Plane(const Plane& plane, const Ray& ray, float t, HitRecord& hitRecord)
+        {
+            hitRecord.didHit = true;
+            hitRecord.origin = { ray.origin.x + ray.direction.x * t, ray.origin.y + ray.direction.y * t, ray.origin.z + ray.direction.z * t };
+            hitRecord.materialIndex = plane.materialIndex;
+            hitRecord.normal = plane.normal.Normalized();
+            hitRecord.t = t;
         }
 
         bool IsPointOnTheInsideOfEdge(const Vector3& point, const Vector3& v0, const Vector3& v1, const Vector3& normal)
@@ -80,7 +105,7 @@ namespace dae
             return Vector3::Dot(cross, normal) > 0;
         }
 
-        bool DidHit_MollerTrombore(const Vector3& v0, const Vector3& v1, const Vector3& v2, const Ray& ray, unsigned char materialIndex, const Vector3& transformedNormal, HitRecord& hitRecord)
+        bool DidHit_MollerTrombore(const Vector3& v0, const Vector3& v1, const Vector3& v2, const Ray& ray, float& t, float& u, float& v)
         {
             const Vector3 edge1 = v1 - v0;
             const Vector3 edge2 = v2 - v0;
@@ -93,26 +118,24 @@ namespace dae
 
             const float f = 1.0f / a;
             const Vector3 s = ray.origin - v0;
-            const float u = f * Vector3::Dot(s, h);
+            const float uHit = f * Vector3::Dot(s, h);
 
-            if (u < 0.0f || u > 1.0f)
+            if (uHit < 0.0f || uHit > 1.0f)
                 return false;
 
             const Vector3 q = Vector3::Cross(s, edge1);
-            const float v = f * Vector3::Dot(ray.direction, q);
+            const float vHit = f * Vector3::Dot(ray.direction, q);
 
-            if (v < 0.0f || u + v > 1.0f)
+            if (vHit < 0.0f || uHit + vHit > 1.0f)
                 return false;
 
-            const float t = f * Vector3::Dot(edge2, q);
+            const float tHit = f * Vector3::Dot(edge2, q);
 
-            if (t > ray.min && t < ray.max)
+            if (tHit > ray.min && tHit < ray.max)
             {
-                hitRecord.t = t;
-                hitRecord.origin = ray.origin + ray.direction * t;
-                hitRecord.normal = transformedNormal;
-                hitRecord.materialIndex = materialIndex;
-                hitRecord.didHit = true;
+                t = tHit;
+                u = uHit;
+                v = vHit;
                 return true;
             }
 
@@ -153,12 +176,14 @@ namespace dae
 
         bool HitTest_Triangle(const Triangle& triangle, const Ray& ray)
         {
-            HitRecord temp{};
-            return HitTest_Triangle(triangle.v0, triangle.v1, triangle.v2, triangle.cullMode, triangle.materialIndex, triangle.normal, ray, temp, true);
+            float t{}, u{}, v{};
+            return HitTest_Triangle(triangle.v0, triangle.v1, triangle.v2, triangle.cullMode, triangle.normal, ray, t, u, v);
         }
 
         bool HitTest_SlabTest(const TriangleMesh& mesh, const Ray& ray)
         {
+            RAY_STAT(SlabTests);
+
             const float tx1 = (mesh.transformedMinAABB.x - ray.origin.x) / ray.direction.x;
             const float tx2 = (mesh.transformedMaxAABB.x - ray.origin.x) / ray.direction.x;
 
@@ -180,10 +205,10 @@ namespace dae
             return tmax > 0 && tmax >= tmin;
         }
 
-        bool HitTest_Triangle(Vector3 v1, Vector3 v2, Vector3 v3, TriangleCullMode cullMode, unsigned char materialIndex, const Vector3& transformedNormal,
-            const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord)
+        bool HitTest_Triangle(const Vector3& v0, const Vector3& v1, const Vector3& v2, TriangleCullMode cullMode, const Vector3& transformedNormal,
+            const Ray& ray, float& t, float& u, float& v)
         {
-            hitRecord.didHit = false;
+            RAY_STAT(TriangleTests);
 
             if (cullMode == TriangleCullMode::BackFaceCulling
                 && Vector3::Dot(transformedNormal, ray.direction) > 0.f)
@@ -192,49 +217,366 @@ namespace dae
                 && Vector3::Dot(transformedNormal, ray.direction) < 0.f)
                 return false;
 
-            return DidHit_MollerTrombore(v1, v2, v3, ray, materialIndex, transformedNormal, hitRecord);
+            return DidHit_MollerTrombore(v0, v1, v2, ray, t, u, v);
             //return DidHit(triangle, ray, hitRecord);
         }
 
-        bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord)
+        namespace
         {
-            if (!HitTest_SlabTest(mesh, ray))
+            //Shared by meshes (world space positions) and instances (object space positions)
+            bool HitTest_Triangles(const std::vector<Vector3>& positions, const std::vector<Vector3>& normals, const std::vector<int>& indices,
+                TriangleCullMode cullMode, const Ray& ray, HitCandidate& candidate)
+            {
+                //Shrink max on every hit so farther triangles get rejected early
+                Ray meshRay{ ray };
+                bool didHit = false;
+                float t{}, u{}, v{};
+
+                const size_t triangleCount = indices.size() / 3;
+                for (size_t i = 0; i < triangleCount; ++i)
+                {
+                    if (HitTest_Triangle(
+                        positions[indices[i * 3]],
+                        positions[indices[i * 3 + 1]],
+                        positions[indices[i * 3 + 2]],
+                        cullMode,
+                        normals[i],
+                        meshRay,
+                        t, u, v))
+                    {
+                        meshRay.max = t;
+
+                        candidate.t = t;
+                        candidate.u = u;
+                        candidate.v = v;
+                        candidate.triangleIndex = static_cast<unsigned int>(i);
+                        didHit = true;
+                    }
+                }
+
+                return didHit;
+            }
+
+            //Any hit is enough here, no need to look for the closest one
+            bool DoesHit_Triangles(const std::vector<Vector3>& positions, const std::vector<Vector3>& normals, const std::vector<int>& indices,
+                TriangleCullMode cullMode, const Ray& ray, unsigned int& triangleIndex)
+            {
+                float t{}, u{}, v{};
+
+                const size_t triangleCount = indices.size() / 3;
+                for (size_t i = 0; i < triangleCount; ++i)
+                {
+                    if (HitTest_Triangle(
+                        positions[indices[i * 3]],
+                        positions[indices[i * 3 + 1]],
+                        positions[indices[i * 3 + 2]],
+                        cullMode,
+                        normals[i],
+                        ray,
+                        t, u, v))
+                    {
+                        triangleIndex = static_cast<unsigned int>(i);
+                        return true;
+                    }
+                }
+
                 return false;
+            }
 
-            float closestT = FLT_MAX;
-            bool didHit = false;
-            HitRecord tempHit;
+            //Rays transposed to one register per component, lane i is rays[i]
+            struct RayPacket
+            {
+                __m128 originX, originY, originZ;
+                __m128 directionX, directionY, directionZ;
+                __m128 min, max;
+            };
 
-            const size_t triangleCount = mesh.indices.size() / 3;
-            for (size_t i = 0; i < triangleCount; ++i)
+            RayPacket LoadRayPacket(const Ray (&rays)[4])
             {
-                if (HitTest_Triangle(
-                    mesh.transformedPositions[mesh.indices[i * 3]],
-                    mesh.transformedPositions[mesh.indices[i * 3 + 1]],
-                    mesh.transformedPositions[mesh.indices[i * 3 + 2]],
-                    mesh.cullMode,
-                    mesh.materialIndex,
-                    mesh.transformedNormals[i],
-                    ray,
-                    tempHit,
-                    ignoreHitRecord))
+                RayPacket packet{};
+                packet.originX = _mm_setr_ps(rays[0].origin.x, rays[1].origin.x, rays[2].origin.x, rays[3].origin.x);
+                packet.originY = _mm_setr_ps(rays[0].origin.y, rays[1].origin.y, rays[2].origin.y, rays[3].origin.y);
+                packet.originZ = _mm_setr_ps(rays[0].origin.z, rays[1].origin.z, rays[2].origin.z, rays[3].origin.z);
+                packet.directionX = _mm_setr_ps(rays[0].direction.x, rays[1].direction.x, rays[2].direction.x, rays[3].direction.x);
+                packet.directionY = _mm_setr_ps(rays[0].direction.y, rays[1].direction.y, rays[2].direction.y, rays[3].direction.y);
+                packet.directionZ = _mm_setr_ps(rays[0].direction.z, rays[1].direction.z, rays[2].direction.z, rays[3].direction.z);
+                packet.min = _mm_setr_ps(rays[0].min, rays[1].min, rays[2].min, rays[3].min);
+                packet.max = _mm_setr_ps(rays[0].max, rays[1].max, rays[2].max, rays[3].max);
+                return packet;
+            }
+
+            //a * b + c * d + e * f, in the same order as Vector3::Dot
+            __m128 Dot(__m128 a, __m128 b, __m128 c, __m128 d, __m128 e, __m128 f)
+            {
+                return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, b), _mm_mul_ps(c, d)), _mm_mul_ps(e, f));
+            }
+
+            //a * b - c * d, one component of Vector3::Cross
+            __m128 CrossTerm(__m128 a, __m128 b, __m128 c, __m128 d)
+            {
+                return _mm_sub_ps(_mm_mul_ps(a, b), _mm_mul_ps(c, d));
+            }
+
+            //HitTest_Triangle for 4 rays: the same float operations lane by lane, so every lane agrees with the single ray test
+            int DoesHit_Triangles(const std::vector<Vector3>& positions, const std::vector<Vector3>& normals, const std::vector<int>& indices,
+                TriangleCullMode cullMode, const RayPacket& packet, int activeMask, unsigned int& triangleIndex)
+            {
+                const __m128 signMask{ _mm_set1_ps(-0.f) };
+                const __m128 zero{ _mm_setzero_ps() };
+                const __m128 one{ _mm_set1_ps(1.f) };
+                const __m128 parallelLimit{ _mm_set1_ps(1e-6f) };
+
+                int hitMask{ 0 };
+                const size_t triangleCount = indices.size() / 3;
+                for (size_t i = 0; i < triangleCount; ++i)
                 {
-                    if (tempHit.t < closestT)
+                    const int testMask{ activeMask & ~hitMask };
+                    RAY_STATS(TriangleTests, (testMask & 1) + ((testMask >> 1) & 1) + ((testMask >> 2) & 1) + ((testMask >> 3) & 1));
+
+                    const Vector3& v0{ positions[indices[i * 3]] };
+                    const Vector3 edge1{ positions[indices[i * 3 + 1]] - v0 };
+                    const Vector3 edge2{ positions[indices[i * 3 + 2]] - v0 };
+
+                    //Lanes that are out, NaNs never reject just like the single ray comparisons
+                    __m128 isRejected{ zero };
+                    if (cullMode != TriangleCullMode::NoCulling)
                     {
-                        closestT = tempHit.t;
-                        hitRecord = tempHit;
-                        didHit = true;
+                        const Vector3& normal{ normals[i] };
+                        const __m128 facing{ Dot(_mm_set1_ps(normal.x), packet.directionX, _mm_set1_ps(normal.y), packet.directionY, _mm_set1_ps(normal.z), packet.directionZ) };
+                        isRejected = cullMode == TriangleCullMode::BackFaceCulling ? _mm_cmpgt_ps(facing, zero) : _mm_cmplt_ps(facing, zero);
                     }
+
+                    const __m128 edge1X{ _mm_set1_ps(edge1.x) }, edge1Y{ _mm_set1_ps(edge1.y) }, edge1Z{ _mm_set1_ps(edge1.z) };
+                    const __m128 edge2X{ _mm_set1_ps(edge2.x) }, edge2Y{ _mm_set1_ps(edge2.y) }, edge2Z{ _mm_set1_ps(edge2.z) };
+
+                    const __m128 hX{ CrossTerm(packet.directionY, edge2Z, packet.directionZ, edge2Y) };
+                    const __m128 hY{ CrossTerm(packet.directionZ, edge2X, packet.directionX, edge2Z) };
+                    const __m128 hZ{ CrossTerm(packet.directionX, edge2Y, packet.directionY, edge2X) };
+                    const __m128 a{ Dot(edge1X, hX, edge1Y, hY, edge1Z, hZ) };
+                    isRejected = _mm_or_ps(isRejected, _mm_cmplt_ps(_mm_andnot_ps(signMask, a), parallelLimit));
+
+                    const __m128 f{ _mm_div_ps(one, a) };
+                    const __m128 sX{ _mm_sub_ps(packet.originX, _mm_set1_ps(v0.x)) };
+                    const __m128 sY{ _mm_sub_ps(packet.originY, _mm_set1_ps(v0.y)) };
+                    const __m128 sZ{ _mm_sub_ps(packet.originZ, _mm_set1_ps(v0.z)) };
+                    const __m128 u{ _mm_mul_ps(f, Dot(sX, hX, sY, hY, sZ, hZ)) };
+                    isRejected = _mm_or_ps(isRejected, _mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmpgt_ps(u, one)));
+
+                    const __m128 qX{ CrossTerm(sY, edge1Z, sZ, edge1Y) };
+                    const __m128 qY{ CrossTerm(sZ, edge1X, sX, edge1Z) };
+                    const __m128 qZ{ CrossTerm(sX, edge1Y, sY, edge1X) };
+                    const __m128 v{ _mm_mul_ps(f, Dot(packet.directionX, qX, packet.directionY, qY, packet.directionZ, qZ)) };
+                    isRejected = _mm_or_ps(isRejected, _mm_or_ps(_mm_cmplt_ps(v, zero), _mm_cmpgt_ps(_mm_add_ps(u, v), one)));
+
+                    const __m128 t{ _mm_mul_ps(f, Dot(edge2X, qX, edge2Y, qY, edge2Z, qZ)) };
+                    const __m128 isInRange{ _mm_and_ps(_mm_cmpgt_ps(t, packet.min), _mm_cmplt_ps(t, packet.max)) };
+
+                    const int triangleHits{ _mm_movemask_ps(_mm_andnot_ps(isRejected, isInRange)) & testMask };
+                    if (triangleHits == 0)
+                        continue;
+
+                    hitMask |= triangleHits;
+                    triangleIndex = static_cast<unsigned int>(i);
+                    if (hitMask == activeMask)
+                        break;
                 }
+
+                return hitMask;
+            }
+
+            bool HitTest_SingleTriangle(const std::vector<Vector3>& positions, const std::vector<Vector3>& normals, const std::vector<int>& indices,
+                TriangleCullMode cullMode, unsigned int triangleIndex, const Ray& ray, HitCandidate& candidate)
+            {
+                float t{}, u{}, v{};
+                if (!HitTest_Triangle(
+                    positions[indices[triangleIndex * 3]],
+                    positions[indices[triangleIndex * 3 + 1]],
+                    positions[indices[triangleIndex * 3 + 2]],
+                    cullMode,
+                    normals[triangleIndex],
+                    ray,
+                    t, u, v))
+                    return false;
+
+                candidate.t = t;
+                candidate.u = u;
+                candidate.v = v;
+                candidate.triangleIndex = triangleIndex;
+                return true;
             }
 
-            return didHit;
+            Ray ToObjectSpace(const TriangleMeshInstance& instance, const Ray& ray)
+            {
+                //Direction stays unnormalized so t is the same in both spaces
+                Ray objectRay{ ray };
+                objectRay.origin = instance.inverseWorldTransform.TransformPoint(ray.origin);
+                objectRay.direction = instance.inverseWorldTransform.TransformVector(ray.direction);
+                return objectRay;
+            }
+        }
+
+        bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitCandidate& candidate)
+        {
+            if (!HitTest_SlabTest(mesh, ray))
+                return false;
+
+            return HitTest_Triangles(mesh.transformedPositions, mesh.transformedNormals, mesh.indices, mesh.cullMode, ray, candidate);
+        }
+
+        bool HitTest_TriangleMesh(const TriangleMesh& mesh, unsigned int triangleIndex, const Ray& ray, HitCandidate& candidate)
+        {
+            return HitTest_SingleTriangle(mesh.transformedPositions, mesh.transformedNormals, mesh.indices, mesh.cullMode, triangleIndex, ray, candidate);
         }
 
         bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
         {
-            HitRecord temp{};
-            return HitTest_TriangleMesh(mesh, ray, temp, true);
+            return HitTest_TriangleMesh(mesh, ray, mesh.cullMode);
+        }
+
+        bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, TriangleCullMode cullMode)
+        {
+            unsigned int triangleIndex{};
+            return HitTest_TriangleMesh(mesh, ray, cullMode, triangleIndex);
+        }
+
+        bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, TriangleCullMode cullMode, unsigned int& triangleIndex)
+        {
+            if (!HitTest_SlabTest(mesh, ray))
+                return false;
+
+            return DoesHit_Triangles(mesh.transformedPositions, mesh.transformedNormals, mesh.indices, cullMode, ray, triangleIndex);
+        }
+
+        bool HitTest_TriangleMesh(const TriangleMesh& mesh, unsigned int triangleIndex, const Ray& ray, TriangleCullMode cullMode)
+        {
+            if (!HitTest_SlabTest(mesh, ray))
+                return false;
+
+            HitCandidate candidate{};
+            return HitTest_SingleTriangle(mesh.transformedPositions, mesh.transformedNormals, mesh.indices, cullMode, triangleIndex, ray, candidate);
+        }
+
+        int HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray (&rays)[4], int activeMask, TriangleCullMode cullMode, unsigned int& triangleIndex)
+        {
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                if ((activeMask & (1 << lane)) && !HitTest_SlabTest(mesh, rays[lane]))
+                    activeMask &= ~(1 << lane);
+            }
+            if (activeMask == 0)
+                return 0;
+
+            return DoesHit_Triangles(mesh.transformedPositions, mesh.transformedNormals, mesh.indices, cullMode, LoadRayPacket(rays), activeMask, triangleIndex);
+        }
+
+        void GetHitAttributes_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, const HitCandidate& candidate, HitRecord& hitRecord)
+        {
+            hitRecord.t = candidate.t;
+            hitRecord.origin = ray.origin + ray.direction * candidate.t;
+            hitRecord.normal = mesh.transformedNormals[candidate.triangleIndex];
+            hitRecord.materialIndex = mesh.materialIndex;
+            hitRecord.didHit = true;
+        }
+
+        bool HitTest_SlabTest(const Vector3& minAABB, const Vector3& maxAABB, const Ray& ray)
+        {
+            RAY_STAT(SlabTests);
+
+            const float tx1 = (minAABB.x - ray.origin.x) / ray.direction.x;
+            const float tx2 = (maxAABB.x - ray.origin.x) / ray.direction.x;
+
+            float tmin = std::min(tx1, tx2);
+            float tmax = std::max(tx1, tx2);
+
+            const float ty1 = (minAABB.y - ray.origin.y) / ray.direction.y;
+            const float ty2 = (maxAABB.y - ray.origin.y) / ray.direction.y;
+
+            tmin = std::max(tmin, std::min(ty1, ty2));
+            tmax = std::min(tmax, std::max(ty1, ty2));
+
+            const float tz1 = (minAABB.z - ray.origin.z) / ray.direction.z;
+            const float tz2 = (maxAABB.z - ray.origin.z) / ray.direction.z;
+
+            tmin = std::max(tmin, std::min(tz1, tz2));
+            tmax = std::min(tmax, std::max(tz1, tz2));
+
+            return tmax >= std::max(tmin, ray.min) && tmin <= ray.max;
+        }
+
+        bool HitTest_MeshInstance(const TriangleMeshInstance& instance, const Ray& ray, HitCandidate& candidate)
+        {
+            if (!HitTest_SlabTest(instance.transformedMinAABB, instance.transformedMaxAABB, ray))
+                return false;
+
+            const MeshData& meshData = *instance.pMeshData;
+            return HitTest_Triangles(meshData.positions, meshData.normals, meshData.indices, instance.cullMode, ToObjectSpace(instance, ray), candidate);
+        }
+
+        bool HitTest_MeshInstance(const TriangleMeshInstance& instance, unsigned int triangleIndex, const Ray& ray, HitCandidate& candidate)
+        {
+            const MeshData& meshData = *instance.pMeshData;
+            return HitTest_SingleTriangle(meshData.positions, meshData.normals, meshData.indices, instance.cullMode, triangleIndex, ToObjectSpace(instance, ray), candidate);
+        }
+
+        bool HitTest_MeshInstance(const TriangleMeshInstance& instance, const Ray& ray, TriangleCullMode cullMode)
+        {
+            unsigned int triangleIndex{};
+            return HitTest_MeshInstance(instance, ray, cullMode, triangleIndex);
+        }
+
+        bool HitTest_MeshInstance(const TriangleMeshInstance& instance, const Ray& ray, TriangleCullMode cullMode, unsigned int& triangleIndex)
+        {
+            if (!HitTest_SlabTest(instance.transformedMinAABB, instance.transformedMaxAABB, ray))
+                return false;
+
+            const MeshData& meshData = *instance.pMeshData;
+            return DoesHit_Triangles(meshData.positions, meshData.normals, meshData.indices, cullMode, ToObjectSpace(instance, ray), triangleIndex);
+        }
+
+        bool HitTest_MeshInstance(const TriangleMeshInstance& instance, unsigned int triangleIndex, const Ray& ray, TriangleCullMode cullMode)
+        {
+            if (!HitTest_SlabTest(instance.transformedMinAABB, instance.transformedMaxAABB, ray))
+                return false;
+
+            const MeshData& meshData = *instance.pMeshData;
+            HitCandidate candidate{};
+            return HitTest_SingleTriangle(meshData.positions, meshData.normals, meshData.indices, cullMode, triangleIndex, ToObjectSpace(instance, ray), candidate);
+        }
+
+        int HitTest_MeshInstance(const TriangleMeshInstance& instance, const Ray (&rays)[4], int activeMask, TriangleCullMode cullMode, unsigned int& triangleIndex)
+        {
+            Ray objectRays[4]{};
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                if (!(activeMask & (1 << lane)))
+                    continue;
+
+                if (HitTest_SlabTest(instance.transformedMinAABB, instance.transformedMaxAABB, rays[lane]))
+                    objectRays[lane] = ToObjectSpace(instance, rays[lane]);
+                else
+                    activeMask &= ~(1 << lane);
+            }
+            if (activeMask == 0)
+                return 0;
+
+            const MeshData& meshData = *instance.pMeshData;
+            return DoesHit_Triangles(meshData.positions, meshData.normals, meshData.indices, cullMode, LoadRayPacket(objectRays), activeMask, triangleIndex);
+        }
+
+        void GetHitAttributes_MeshInstance(const TriangleMeshInstance& instance, const Ray& ray, const HitCandidate& candidate, HitRecord& hitRecord)
+        {
+            //Normals transform with the inverse transpose, so dot with the rows of the inverse
+            const Vector3& objectNormal = instance.pMeshData->normals[candidate.triangleIndex];
+            const Matrix& inverse = instance.inverseWorldTransform;
+
+            hitRecord.t = candidate.t;
+            hitRecord.origin = ray.origin + ray.direction * candidate.t;
+            hitRecord.normal = Vector3{
+                Vector3::Dot(inverse.GetAxisX(), objectNormal),
+                Vector3::Dot(inverse.GetAxisY(), objectNormal),
+                Vector3::Dot(inverse.GetAxisZ(), objectNormal) }.Normalized();
+            hitRecord.materialIndex = instance.materialIndex;
+            hitRecord.didHit = true;
         }
     }
 
@@ -254,56 +596,225 @@ namespace dae
 
     namespace Utils
     {
-        bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
+        namespace
         {
-            std::ifstream file(filename);
-            if (!file)
-                return false;
+            //Everything one thread found in its part of the file
+            struct OBJChunk
+            {
+                const char* pBegin{};
+                const char* pEnd{};
+
+                std::vector<Vector3> positions{};
+                std::vector<int> indices{};
+
+                //Negative indices point backwards from the current vertex, these still need the vertex offset of the chunk
+                std::vector<size_t> relativeIndices{};
+            };
+
+            const char* SkipSpaces(const char* pCurrent, const char* pEnd)
+            {
+                while (pCurrent < pEnd && (*pCurrent == ' ' || *pCurrent == '\t'))
+                    ++pCurrent;
+                return pCurrent;
+            }
+
+            const char* SkipLine(const char* pCurrent, const char* pEnd)
+            {
+                while (pCurrent < pEnd && *pCurrent != '\n')
+                    ++pCurrent;
+                return pCurrent < pEnd ? pCurrent + 1 : pEnd;
+            }
 
-            std::string sCommand;
-            while (!file.eof())
+            const char* ParseFloat(const char* pCurrent, const char* pEnd, float& value)
             {
-                file >> sCommand;
-                if (sCommand == "#")
+                pCurrent = SkipSpaces(pCurrent, pEnd);
+                //from_chars doesn't accept a leading '+'
+                if (pCurrent < pEnd && *pCurrent == '+')
+                    ++pCurrent;
+
+                const auto result = std::from_chars(pCurrent, pEnd, value);
+                if (result.ec != std::errc{})
+                    value = 0.f;
+                return result.ptr;
+            }
+
+            const char* ParseInt(const char* pCurrent, const char* pEnd, int& value, bool& isValid)
+            {
+                //from_chars doesn't accept a leading '+'
+                if (pCurrent < pEnd && *pCurrent == '+')
+                    ++pCurrent;
+
+                //Indices that don't fit an int are invalid instead of wrapping around, their digits are still consumed
+                const auto result = std::from_chars(pCurrent, pEnd, value);
+                isValid = result.ec == std::errc{};
+                return result.ptr;
+            }
+
+            //Parses "f v v/vt v//vn v/vt/vn ..." and fans polygons into triangles
+            const char* ParseFace(const char* pCurrent, const char* pEnd, OBJChunk& chunk)
+            {
+                constexpr int maxCorners{ 64 };
+                int polygon[maxCorners]{};
+                bool isRelative[maxCorners]{};
+                int cornerCount = 0;
+
+                while (true)
                 {
-                    // Ignore Comment
+                    pCurrent = SkipSpaces(pCurrent, pEnd);
+                    if (pCurrent >= pEnd || *pCurrent == '\n' || *pCurrent == '\r' || *pCurrent == '#')
+                        break;
+
+                    int index{};
+                    bool isValid{};
+                    pCurrent = ParseInt(pCurrent, pEnd, index, isValid);
+
+                    //Only the position index is used, skip "/vt/vn"
+                    while (pCurrent < pEnd && *pCurrent != ' ' && *pCurrent != '\t' && *pCurrent != '\n' && *pCurrent != '\r')
+                        ++pCurrent;
+
+                    if (!isValid || index == 0 || cornerCount >= maxCorners)
+                        continue;
+
+                    //Positive indices are 1-based, negative ones count back from the last vertex parsed so far
+                    isRelative[cornerCount] = index < 0;
+                    polygon[cornerCount] = index > 0 ? index - 1 : static_cast<int>(chunk.positions.size()) + index;
+                    ++cornerCount;
                 }
-                else if (sCommand == "v")
+
+                for (int corner = 1; corner + 1 < cornerCount; ++corner)
                 {
-                    float x, y, z;
-                    file >> x >> y >> z;
-                    positions.push_back({ x, y, z });
+                    for (const int polygonIndex : { 0, corner, corner + 1 })
+                    {
+                        if (isRelative[polygonIndex])
+                            chunk.relativeIndices.push_back(chunk.indices.size());
+                        chunk.indices.push_back(polygon[polygonIndex]);
+                    }
                 }
-                else if (sCommand == "f")
+
+                return pCurrent;
+            }
+
+            void ParseChunk(OBJChunk& chunk)
+            {
+                //Rough guess from typical line lengths, avoids most regrowth
+                const size_t chunkSize = static_cast<size_t>(chunk.pEnd - chunk.pBegin);
+                chunk.positions.reserve(chunkSize / 64);
+                chunk.indices.reserve(chunkSize / 16);
+
+                const char* pCurrent = chunk.pBegin;
+                const char* pEnd = chunk.pEnd;
+                while (pCurrent < pEnd)
                 {
-                    float i0, i1, i2;
-                    file >> i0 >> i1 >> i2;
+                    pCurrent = SkipSpaces(pCurrent, pEnd);
+                    if (pEnd - pCurrent >= 2 && pCurrent[0] == 'v' && (pCurrent[1] == ' ' || pCurrent[1] == '\t'))
+                    {
+                        Vector3 position{};
+                        pCurrent = ParseFloat(pCurrent + 2, pEnd, position.x);
+                        pCurrent = ParseFloat(pCurrent, pEnd, position.y);
+                        pCurrent = ParseFloat(pCurrent, pEnd, position.z);
+                        chunk.positions.push_back(position);
+                    }
+                    else if (pEnd - pCurrent >= 2 && pCurrent[0] == 'f' && (pCurrent[1] == ' ' || pCurrent[1] == '\t'))
+                    {
+                        pCurrent = ParseFace(pCurrent + 2, pEnd, chunk);
+                    }
 
-                    indices.push_back((int)i0 - 1);
-                    indices.push_back((int)i1 - 1);
-                    indices.push_back((int)i2 - 1);
+                    //Comments, vt, vn, groups, materials, ... are ignored
+                    pCurrent = SkipLine(pCurrent, pEnd);
                 }
-                file.ignore(1000, '\n');
+            }
+        }
+
+        bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
+        {
+            PROFILE_ZONE("Utils::ParseOBJ");
+
+            const MappedFile file{ filename };
+            if (!file.IsValid())
+                return false;
 
-                if (file.eof())
-                    break;
+            const char* pData = file.GetData();
+            const size_t fileSize = file.GetSize();
+
+            //Split on line boundaries, small files aren't worth the extra threads
+            constexpr size_t minChunkSize{ 1 << 20 };
+            const size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+            const size_t chunkCount = std::max<size_t>(1, std::min(threadCount, fileSize / minChunkSize));
+
+            std::vector<OBJChunk> chunks(chunkCount);
+            const char* pChunkBegin = pData;
+            for (size_t i = 0; i < chunkCount; ++i)
+            {
+                const char* pChunkEnd = (i + 1 == chunkCount) ? pData + fileSize : pData + fileSize * (i + 1) / chunkCount;
+                pChunkEnd = SkipLine(std::max(pChunkEnd, pChunkBegin), pData + fileSize);
+
+                chunks[i].pBegin = pChunkBegin;
+                chunks[i].pEnd = pChunkEnd;
+                pChunkBegin = pChunkEnd;
             }
 
-            for (uint64_t index = 0; index < indices.size(); index += 3)
+            concurrency::parallel_for(size_t(0), chunkCount, [&](size_t i)
+                {
+                    ParseChunk(chunks[i]);
+                });
+
+            //Prefix sums give every chunk its spot in the final arrays
+            std::vector<size_t> positionOffsets(chunkCount + 1);
+            std::vector<size_t> indexOffsets(chunkCount + 1);
+            for (size_t i = 0; i < chunkCount; ++i)
             {
-                uint32_t i0 = indices[index];
-                uint32_t i1 = indices[index + 1];
-                uint32_t i2 = indices[index + 2];
+                positionOffsets[i + 1] = positionOffsets[i] + chunks[i].positions.size();
+                indexOffsets[i + 1] = indexOffsets[i] + chunks[i].indices.size();
+            }
+
+            positions.clear();
+            indices.clear();
+            positions.resize(positionOffsets[chunkCount]);
+            indices.resize(indexOffsets[chunkCount]);
 
-                Vector3 edgeV0V1 = positions[i1] - positions[i0];
-                Vector3 edgeV0V2 = positions[i2] - positions[i0];
-                Vector3 normal = Vector3::Cross(edgeV0V1, edgeV0V2);
+            concurrency::parallel_for(size_t(0), chunkCount, [&](size_t i)
+                {
+                    OBJChunk& chunk = chunks[i];
+                    for (const size_t relativeIndex : chunk.relativeIndices)
+                        chunk.indices[relativeIndex] += static_cast<int>(positionOffsets[i]);
 
-                normal.Normalize();
+                    std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionOffsets[i]);
+                    std::copy(chunk.indices.begin(), chunk.indices.end(), indices.begin() + indexOffsets[i]);
+                });
 
-                normals.push_back(normal);
+            //Faces pointing outside the vertex list would read garbage later on
+            const int positionCount = static_cast<int>(positions.size());
+            for (const int index : indices)
+            {
+                if (index < 0 || index >= positionCount)
+                    return false;
             }
 
+            const size_t triangleCount = indices.size() / 3;
+            normals.clear();
+            normals.resize(triangleCount);
+            concurrency::parallel_for(size_t(0), triangleCount, [&](size_t i)
+                {
+                    const Vector3 edgeV0V1 = positions[indices[i * 3 + 1]] - positions[indices[i * 3]];
+                    const Vector3 edgeV0V2 = positions[indices[i * 3 + 2]] - positions[indices[i * 3]];
+                    normals[i] = Vector3::Cross(edgeV0V1, edgeV0V2).Normalized();
+                });
+
+            return true;
+        }
+
+        bool LoadOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices, bool useCache)
+        {
+            if (useCache && MeshCache::Read(filename, positions, normals, indices))
+                return true;
+
+            if (!ParseOBJ(filename, positions, normals, indices))
+                return false;
+
+            //A failed write only costs the next launch a parse
+            if (useCache)
+                MeshCache::Write(filename, positions, normals, indices);
+
             return true;
         }
     }
@@ -10,23 +10,46 @@ namespace dae
     namespace GeometryUtils
     {
         // Sphere Hit-Tests
-        bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false);
+        bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, float& t);
         bool HitTest_Sphere(const Sphere& sphere, const Ray& ray);
+        void GetHitAttributes_Sphere(const Sphere& sphere, const Ray& ray, float t, HitRecord& hitRecord);
 
         // Plane Hit-Tests
-        bool HitTest_Plane(const Plane& plane, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false);
+        bool HitTest_Plane(const Plane& plane, const Ray& ray, float& t);
         bool HitTest_Plane(const Plane& plane, const Ray& ray);
+        void GetHitAttributes_Plane(const Plane& plane, const Ray& ray, float t, HitRecord& hitRecord);
 
         // Triangle Hit-Tests
         bool IsPointOnTheInsideOfEdge(const Vector3& point, const Vector3& v0, const Vector3& v1, const Vector3& normal);
-        bool HitTest_Triangle(Vector3 v1, Vector3 v2, Vector3 v3, TriangleCullMode cullMode, unsigned char materialIndex, const Vector3& transformedNormal,
-            const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false);
+        bool HitTest_Triangle(const Vector3& v0, const Vector3& v1, const Vector3& v2, TriangleCullMode cullMode, const Vector3& transformedNormal,
+            const Ray& ray, float& t, float& u, float& v);
         bool HitTest_Triangle(const Triangle& triangle, const Ray& ray);
 
         // Triangle Mesh Hit-Tests
         bool HitTest_SlabTest(const TriangleMesh& mesh, const Ray& ray);
-        bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false);
+        bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitCandidate& candidate);
+        //Single triangle of the mesh, for when visibility is already known
+        bool HitTest_TriangleMesh(const TriangleMesh& mesh, unsigned int triangleIndex, const Ray& ray, HitCandidate& candidate);
         bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray);
+        bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, TriangleCullMode cullMode);
+        //Any hit, triangleIndex is the one that blocks the ray
+        bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, TriangleCullMode cullMode, unsigned int& triangleIndex);
+        //Any hit on one triangle, with the same bounds test as the whole mesh
+        bool HitTest_TriangleMesh(const TriangleMesh& mesh, unsigned int triangleIndex, const Ray& ray, TriangleCullMode cullMode);
+        //4 shadow rays at once, only the ones in activeMask get tested. Bit i of the result is set when rays[i] hits,
+        //triangleIndex is the last triangle that blocked any of them
+        int HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray (&rays)[4], int activeMask, TriangleCullMode cullMode, unsigned int& triangleIndex);
+        void GetHitAttributes_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, const HitCandidate& candidate, HitRecord& hitRecord);
+
+        // Triangle Mesh Instance Hit-Tests
+        bool HitTest_SlabTest(const Vector3& minAABB, const Vector3& maxAABB, const Ray& ray);
+        bool HitTest_MeshInstance(const TriangleMeshInstance& instance, const Ray& ray, HitCandidate& candidate);
+        bool HitTest_MeshInstance(const TriangleMeshInstance& instance, unsigned int triangleIndex, const Ray& ray, HitCandidate& candidate);
+        bool HitTest_MeshInstance(const TriangleMeshInstance& instance, const Ray& ray, TriangleCullMode cullMode);
+        bool HitTest_MeshInstance(const TriangleMeshInstance& instance, const Ray& ray, TriangleCullMode cullMode, unsigned int& triangleIndex);
+        bool HitTest_MeshInstance(const TriangleMeshInstance& instance, unsigned int triangleIndex, const Ray& ray, TriangleCullMode cullMode);
+        int HitTest_MeshInstance(const TriangleMeshInstance& instance, const Ray (&rays)[4], int activeMask, TriangleCullMode cullMode, unsigned int& triangleIndex);
+        void GetHitAttributes_MeshInstance(const TriangleMeshInstance& instance, const Ray& ray, const HitCandidate& candidate, HitRecord& hitRecord);
     }
 
     namespace LightUtils
@@ -38,5 +61,8 @@ namespace dae
     namespace Utils
     {
         bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices);
+
+        //Uses the binary cache next to the OBJ when it's up to date, otherwise parses the OBJ and (re)writes the cache
+        bool LoadOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices, bool useCache = true);
     }
 }
\ No newline at end of file
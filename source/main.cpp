@@ -6,11 +6,19 @@
 
 //Standard includes
 #include <iostream>
+#include <string>
 
 //Project includes
 #include "Timer.h"
 #include "Renderer.h"
 #include "Scene.h"
+#include "Animation.h"
+#include "Benchmark.h"
+#include "CameraPath.h"
+#include "DistributedRenderer.h"
+#include "Profiler.h"
+#include "Regression.h"
+#include "RenderServer.h"
 
 using namespace dae;
 
@@ -22,9 +30,215 @@ void ShutDown(SDL_Window* pWindow)
 
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	//Headless modes
+	if (argc > 1 && std::string(args[1]) == "--bench-obj")
+	{
+		const unsigned int triangleCount = argc > 2 ? static_cast<unsigned int>(std::stoul(args[2])) : 4'000'000u;
+		Benchmark::RunOBJParseBenchmark(triangleCount);
+		return 0;
+	}
+
+	if (argc > 1 && std::string(args[1]) == "--bench-intersect")
+	{
+		Benchmark::IntersectionBenchmarkSettings settings{};
+		if (argc > 2)
+			settings.rayCount = static_cast<unsigned int>(std::stoul(args[2]));
+		if (settings.rayCount == 0)
+		{
+			std::cout << "Ray count has to be at least 1" << std::endl;
+			return 1;
+		}
+		Benchmark::RunIntersectionBenchmark(settings);
+		return 0;
+	}
+
+	if (argc > 3 && std::string(args[1]) == "--worker")
+		return Distributed::RunWorker(args[2], static_cast<uint16_t>(std::stoi(args[3])));
+
+	if (argc > 1 && std::string(args[1]) == "--coordinator")
+	{
+		Distributed::CoordinatorSettings settings{};
+		settings.executable = args[0];
+		for (int i = 2; i < argc; ++i)
+		{
+			const std::string arg{ args[i] };
+			const bool hasValue{ i + 1 < argc };
+
+			if (arg == "--workers" && hasValue)
+				settings.workerCount = std::stoi(args[++i]);
+			else if (arg == "--local-workers" && hasValue)
+				settings.localWorkerCount = std::stoi(args[++i]);
+			else if (arg == "--port" && hasValue)
+				settings.port = static_cast<uint16_t>(std::stoi(args[++i]));
+			else if (arg == "--scene" && hasValue)
+				settings.sceneName = args[++i];
+			else if (arg == "--width" && hasValue)
+				settings.width = std::stoi(args[++i]);
+			else if (arg == "--height" && hasValue)
+				settings.height = std::stoi(args[++i]);
+			else if (arg == "--time" && hasValue)
+				settings.time = std::stof(args[++i]);
+			else if (arg == "--straggler-timeout" && hasValue)
+				settings.stragglerTimeout = std::stof(args[++i]);
+			else if (arg == "--output" && hasValue)
+				settings.outputFile = args[++i];
+			else if (arg == "--no-shadows")
+				settings.shadowsEnabled = false;
+			else if (arg == "--rasterize")
+				settings.primaryVisibility = Renderer::PrimaryVisibility::Rasterized;
+			else if (arg == "--light-samples" && hasValue)
+			{
+				settings.lightSampling = Renderer::LightSampling::Importance;
+				settings.lightSamplesPerHit = std::stoi(args[++i]);
+			}
+			else if (arg == "--light-cutoff" && hasValue)
+				settings.lightCutoff = std::stof(args[++i]);
+			else if (arg == "--lightmap")
+				settings.lightmap = true;
+			else
+				std::cout << "Unknown coordinator argument: " << arg << std::endl;
+		}
+
+		//Local workers count towards the total
+		settings.workerCount = std::max(settings.workerCount, settings.localWorkerCount);
+		return Distributed::RunCoordinator(settings);
+	}
+
+	if (argc > 1 && std::string(args[1]) == "--server")
+	{
+		//Scenes stay initialized between jobs until they no longer fit in this budget
+		size_t cacheMegaBytes{ 512 };
+		if (argc > 3 && std::string(args[2]) == "--cache-mb")
+			cacheMegaBytes = std::stoul(args[3]);
+
+		RenderServer server{ cacheMegaBytes * 1024 * 1024 };
+		server.Run(std::cin, std::cout);
+		return 0;
+	}
+
+	if (argc > 1 && std::string(args[1]) == "--golden")
+	{
+		Regression::GoldenImageSettings settings{};
+		for (int i = 2; i < argc; ++i)
+		{
+			const std::string arg{ args[i] };
+			const bool hasValue{ i + 1 < argc };
+
+			if (arg == "--update")
+				settings.updateReferences = true;
+			else if (arg == "--dir" && hasValue)
+				settings.directory = args[++i];
+			else if (arg == "--scene" && hasValue)
+				settings.sceneFilter = args[++i];
+			else if (arg == "--width" && hasValue)
+				settings.width = std::stoi(args[++i]);
+			else if (arg == "--height" && hasValue)
+				settings.height = std::stoi(args[++i]);
+			else if (arg == "--tolerance" && hasValue)
+				settings.pixelTolerance = std::stoi(args[++i]);
+			else if (arg == "--min-psnr" && hasValue)
+				settings.minPSNR = std::stof(args[++i]);
+			else if (arg == "--max-flip" && hasValue)
+				settings.maxPerceptualError = std::stof(args[++i]);
+			else
+				std::cout << "Unknown golden image argument: " << arg << std::endl;
+		}
+
+		//Non zero exit code when anything changed, so scripts can gate on it
+		return Regression::RunGoldenImageTest(settings) > 0 ? 1 : 0;
+	}
+
+	if (argc > 1 && std::string(args[1]) == "--animation")
+	{
+		Animation::BatchRenderSettings settings{};
+		for (int i = 2; i < argc; ++i)
+		{
+			const std::string arg{ args[i] };
+			const bool hasValue{ i + 1 < argc };
+
+			if (arg == "--frames" && i + 2 < argc)
+			{
+				settings.firstFrame = std::stoi(args[++i]);
+				settings.lastFrame = std::stoi(args[++i]);
+			}
+			else if (arg == "--scene" && hasValue)
+				settings.sceneName = args[++i];
+			else if (arg == "--width" && hasValue)
+				settings.width = std::stoi(args[++i]);
+			else if (arg == "--height" && hasValue)
+				settings.height = std::stoi(args[++i]);
+			else if (arg == "--dt" && hasValue)
+				settings.timeStep = std::stof(args[++i]);
+			else if (arg == "--output" && hasValue)
+				settings.output = args[++i];
+			else if (arg == "--encoders" && hasValue)
+				settings.encoderThreads = std::stoi(args[++i]);
+			else if (arg == "--in-flight" && hasValue)
+				settings.maxFramesInFlight = std::stoi(args[++i]);
+			else if (arg == "--no-shadows")
+				settings.shadowsEnabled = false;
+			else
+				std::cout << "Unknown animation argument: " << arg << std::endl;
+		}
+
+		//A .y4m output is a single video stream, anything else a directory of frames
+		const std::string y4mExtension{ ".y4m" };
+		if (settings.output.size() > y4mExtension.size()
+			&& settings.output.compare(settings.output.size() - y4mExtension.size(), y4mExtension.size(), y4mExtension) == 0)
+			settings.format = Animation::OutputFormat::Y4M;
+
+		return Animation::RunBatchRender(settings);
+	}
+
+	if (argc > 1 && std::string(args[1]) == "--benchmark")
+	{
+		Benchmark::SceneBenchmarkSettings settings{};
+		for (int i = 2; i < argc; ++i)
+		{
+			const std::string arg{ args[i] };
+			const bool hasValue{ i + 1 < argc };
+
+			if (arg == "--frames" && hasValue)
+				settings.frames = std::stoi(args[++i]);
+			else if (arg == "--warmup" && hasValue)
+				settings.warmupFrames = std::stoi(args[++i]);
+			else if (arg == "--width" && hasValue)
+				settings.width = std::stoi(args[++i]);
+			else if (arg == "--height" && hasValue)
+				settings.height = std::stoi(args[++i]);
+			else if (arg == "--dt" && hasValue)
+				settings.timeStep = std::stof(args[++i]);
+			else if (arg == "--scene" && hasValue)
+				settings.sceneFilter = args[++i];
+			else if (arg == "--output" && hasValue)
+				settings.outputFile = args[++i];
+			else if (arg == "--trace" && hasValue)
+				settings.traceFile = args[++i];
+			else if (arg == "--camera-path" && hasValue)
+				settings.cameraPathFile = args[++i];
+			else if (arg == "--no-shadows")
+				settings.shadowsEnabled = false;
+			else if (arg == "--light-samples" && hasValue)
+				settings.lightSamplesPerHit = std::stoi(args[++i]);
+			else if (arg == "--light-cutoff" && hasValue)
+				settings.lightCutoff = std::stof(args[++i]);
+			else if (arg == "--lightmap")
+				settings.lightmap = true;
+			else
+				std::cout << "Unknown benchmark argument: " << arg << std::endl;
+		}
+
+		Benchmark::RunSceneBenchmark(settings);
+		return 0;
+	}
+
+	//Interactive options
+	float fixedTimeStep{ 0.f };
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(args[i]) == "--fixed-dt" && i + 1 < argc)
+			fixedTimeStep = std::stof(args[++i]);
+	}
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -43,16 +257,23 @@ int main(int argc, char* args[])
 
 	//Initialize "framework"
 	const auto pTimer = new Timer();
+	pTimer->SetFixedTimeStep(fixedTimeStep);
 	const auto pRenderer = new Renderer(pWindow);
 
 	const auto pScene = new Scene_W4_BunnyScene();
 	pScene->Initialize();
 
+	//Name it's listed under in GetSceneFactories, so --camera-path can find it again
+	const std::string sceneName{ "Scene_W4_BunnyScene" };
+	CameraPath cameraPath{};
+	bool isRecordingCameraPath{ false };
+
 	//Start loop
 	pTimer->Start();
 	float printTimer = 0.f;
 	bool isLooping = true;
 	bool takeScreenshot = false;
+	bool isIncrementalRendering = false;
 	while (isLooping)
 	{
 		//--------- Get input events ---------
@@ -71,25 +292,113 @@ int main(int argc, char* args[])
 					pRenderer->ToggleShadows();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
 					pRenderer->ToggleLightMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F4)
+					pRenderer->ToggleCostMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+				{
+					if (pRenderer->SaveCostBuffer("cost_buffer.pfm"))
+						std::cout << "Cost buffer saved!" << std::endl;
+					else
+						std::cout << "No cost buffer, enable a cost mode (F4) first" << std::endl;
+				}
 				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
 					pTimer->StartBenchmark();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
+				{
+					//Start/stop a profiler capture
+					if (!Profiler::IsCapturing())
+					{
+						Profiler::BeginCapture();
+						std::cout << "Profiler capture started" << std::endl;
+					}
+					else if (Profiler::EndCapture("trace.json"))
+						std::cout << "Profiler trace saved! Open trace.json in chrome://tracing or Perfetto" << std::endl;
+					else
+						std::cout << "Something went wrong. Trace not saved!" << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+				{
+					//Same frames every run, handy for comparing builds with F6
+					pTimer->SetFixedTimeStep(pTimer->IsFixedTimeStep() ? 0.f : 1.f / 30.f);
+					std::cout << (pTimer->IsFixedTimeStep() ? "Fixed time step (1/30 s)" : "Wall clock time") << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+				{
+					//Start/stop recording the camera for --benchmark --camera-path
+					isRecordingCameraPath = !isRecordingCameraPath;
+					if (isRecordingCameraPath)
+					{
+						cameraPath.Clear();
+						cameraPath.SetSceneName(sceneName);
+						std::cout << "Camera path recording started" << std::endl;
+					}
+					else if (cameraPath.Save("camera_path.rtpath"))
+						std::cout << "Camera path saved! " << cameraPath.GetKeyframes().size() << " frames" << std::endl;
+					else
+						std::cout << "Something went wrong. Camera path not saved!" << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+				{
+					//Keep the pixels nothing moved over while the camera stands still
+					isIncrementalRendering = !isIncrementalRendering;
+					std::cout << (isIncrementalRendering ? "Incremental rendering" : "Full frame rendering") << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+				{
+					pRenderer->TogglePrimaryVisibility();
+					std::cout << (pRenderer->GetPrimaryVisibility() == Renderer::PrimaryVisibility::Rasterized ? "Rasterized primary visibility" : "Ray traced primary visibility") << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F1)
+				{
+					pRenderer->ToggleLightSampling();
+					if (pRenderer->GetLightSampling() == Renderer::LightSampling::Importance)
+						std::cout << "Importance sampled lights (" << pRenderer->GetLightSamplesPerHit() << " per hit)" << std::endl;
+					else
+						std::cout << "All lights" << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_B)
+				{
+					//Bake the static planes for the lights as they are now, moving a light afterwards needs a rebake
+					if (!pRenderer->HasLightmap())
+					{
+						pRenderer->BakeLightmap(pScene);
+						std::cout << "Lightmap baked" << std::endl;
+					}
+					else
+					{
+						pRenderer->ClearLightmap();
+						std::cout << "Lightmap cleared" << std::endl;
+					}
+				}
 				break;
 			}
 		}
 
 		//--------- Update ---------
-		pScene->Update(pTimer);
+		{
+			PROFILE_ZONE("Scene::Update");
+			pScene->Update(pTimer);
+		}
+		if (isRecordingCameraPath)
+			cameraPath.AddKeyframe(pScene->GetCamera(), *pTimer);
 
 		//--------- Render ---------
-		pRenderer->Render(pScene);
+		if (isIncrementalRendering)
+			pRenderer->RenderIncremental(pScene);
+		else
+			pRenderer->Render(pScene);
 
 		//--------- Timer ---------
 		pTimer->Update();
-		printTimer += pTimer->GetElapsed();
+		printTimer += pTimer->GetRealElapsed();
 		if (printTimer >= 1.f)
 		{
 			printTimer = 0.f;
-			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			const FrameTimeHistogram& frameTimes{ pTimer->GetFrameTimes() };
+			std::cout << "dFPS: " << pTimer->GetdFPS()
+				<< " | p50 " << frameTimes.GetPercentile(50.f) << " p90 " << frameTimes.GetPercentile(90.f)
+				<< " p99 " << frameTimes.GetPercentile(99.f) << " max " << frameTimes.GetMax() << " ms"
+				<< " | stutters " << frameTimes.GetStutterCount() << std::endl;
 		}
 
 		//Save screenshot after full render